@@ -33,56 +33,53 @@
 
 // kNumPE = 8
 
+// Start/Done ordering (no fixed trigger delay), start and done travel with the data:
+//   GB forwards a start (done) of a PE group only after the beats of the group streamed before it,
+//   GBSend takes a group start only in a cycle without beat, and passes it to PEStart for each PE 
+//   of the group once the beats before it reached that PE (pe_start_in),
+//   GBRecv takes a PE done only in a cycle without output of that PE, and passes it to PEDone 
+//   once the outputs before it have been pushed to GB (pe_done_array)
+// Per-PE completion:
+//   a start is applied to each PE of the group as soon as that PE is idle, i.e. a PE that finished 
+//   the current timestep starts the next one (GBControlConfig.is_eager) while the group barrier still waits,
+//   PEDone counts the dones of each PE and reports the PEs done with the current timestep (pe_done_status),
+//   only the dones of PEs started by PEStart are counted (pe_start_toggle), a PE can also be
+//   started over its own AXI (PEModule 0x0), that done is dropped and does not change the PE state here,
+//   a PE more than two timesteps ahead of its group barrier overflows done_count, the done is lost
+//   and pe_done_overflow flags the PE until reset
+
 SC_MODULE(PEStart) {
   static const int kDebugLevel = 6;
-  static const int kSendDelay = spec::kGlobalTriggerDelay;
  public:
   sc_in<bool>  clk;
   sc_in<bool>  rst; 
-  Connections::In<bool>           all_pe_start;
+  Connections::In<bool>           pe_start_in[spec::kNumPE];  // from GBSend, inputs before it delivered
   Connections::OutBuffered<bool>  pe_start_array[spec::kNumPE];
+  sc_in<spec::PEMaskType>         pe_done_toggle; // from PEDone
+  sc_out<spec::PEMaskType>        pe_start_toggle; // flips on every start of PE i, to PEDone
 
-  
-  Connections::Combinational<bool> trigger;
-      
   SC_HAS_PROCESS(PEStart);
   PEStart(sc_module_name name)
      : sc_module(name), 
      clk("clk"), 
-     rst("rst")
+     rst("rst"),
+     pe_done_toggle("pe_done_toggle"),
+     pe_start_toggle("pe_start_toggle")
   {
-  
-    SC_THREAD(RecvAllStart);
-    sensitive << clk.pos();
-    async_reset_signal_is(rst, false);
-    
     SC_THREAD(SendPEStart);
     sensitive << clk.pos();
     async_reset_signal_is(rst, false);
   }      
   
-  void RecvAllStart() {
-    all_pe_start.Reset();
-    trigger.ResetWrite();  
-
-    #pragma hls_pipeline_init_interval 1
-    while(1) {
-      bool all_pe_start_reg;
-      if (all_pe_start.PopNB(all_pe_start_reg)) {
-        trigger.Push(1);
-      }
-      
-      wait();
-    }
-  }
   void SendPEStart() {
     #pragma hls_unroll yes    
     for (int i = 0; i < spec::kNumPE; i++) {
+      pe_start_in[i].Reset();
       pe_start_array[i].Reset();
     }
-    trigger.ResetRead();
-    NVUINT6 state = 0;
-    bool trigger_reg = 0;
+    spec::PEMaskType pending = 0;       // PEs still to be started
+    spec::PEMaskType start_toggle = 0;  // PE i is idle if equal to pe_done_toggle
+    pe_start_toggle.write(0);
 
     #pragma hls_pipeline_init_interval 1
     while(1) {
@@ -90,21 +87,27 @@ SC_MODULE(PEStart) {
       for (int i = 0; i < spec::kNumPE; i++) {
         pe_start_array[i].TransferNB();
       }   
-   
 
-      if (state >= kSendDelay && trigger_reg == 1) {
-        trigger_reg = 0;
-        state = 0;
-        #pragma hls_unroll yes    
-        for (int i = 0; i < spec::kNumPE; i++) {
+      // start a PE once it is idle, its done is only toggled after its outputs are delivered 
+      spec::PEMaskType ready = ~(start_toggle ^ pe_done_toggle.read());
+      #pragma hls_unroll yes    
+      for (int i = 0; i < spec::kNumPE; i++) {
+        if (pending[i] && ready[i]) {
+          pending[i] = 0;
+          start_toggle[i] = !start_toggle[i];
           pe_start_array[i].Push(1);
-        }           
-      }
-      else if (state >= 1) {      
-        state += 1;
-      }
-      else if (trigger.PopNB(trigger_reg)) {
-        state = 1;
+        }
+      }           
+      
+      pe_start_toggle.write(start_toggle);
+      
+      // one start per PE is outstanding at a time, GBSend holds the next one
+      #pragma hls_unroll yes    
+      for (int i = 0; i < spec::kNumPE; i++) {
+        bool pe_start_reg;
+        if (!pending[i]) {
+          pending[i] = pe_start_in[i].PopNB(pe_start_reg);
+        }
       }
       
       wait();
@@ -114,23 +117,38 @@ SC_MODULE(PEStart) {
 
 SC_MODULE(PEDone) {
   static const int kDebugLevel = 6;
-  static const int kSendDelay = spec::kGlobalTriggerDelay;
  public:
   sc_in<bool>  clk;
   sc_in<bool>  rst; 
-  Connections::In<bool>   pe_done_array[spec::kNumPE];
-  Connections::Out<bool>  all_pe_done;
+  Connections::In<bool>   pe_done_array[spec::kNumPE];  // from GBRecv, outputs before it delivered
+  Connections::Out<bool>  all_pe_done[spec::kNumPEGroups];
+  sc_in<spec::PEMaskType> pe_group;   // PE group of each PE
+  sc_in<spec::PEMaskType>  pe_start_toggle; // flips on every start of PE i, from PEStart
+  sc_out<spec::PEMaskType> pe_done_toggle;  // flips on every counted done of PE i, to PEStart
+  sc_out<spec::PEMaskType> pe_done_status;  // PE i done with the current timestep (outputs delivered), to GB
+  sc_out<spec::PEMaskType> pe_done_overflow; // PE i had a done with done_count full (not counted), sticky
   
-  Connections::Combinational<bool> trigger;
+  Connections::Combinational<spec::PEGroupType> trigger;
   
   
-  NVUINTW(spec::kNumPE) done_indicator;
+  // a PE started early finishes at most one timestep ahead of the group barrier (count <= 2), 
+  //   a done with count 3 is not counted and sets done_overflow
+  NVUINT2               done_count[spec::kNumPE];
+  NVUINTW(spec::kNumPE) done_overflow;
+  NVUINTW(spec::kNumPE) running;          // started by PEStart, done not counted yet
+  NVUINTW(spec::kNumPE) done_indicator;   // done with the current timestep (first count)
+  NVUINTW(spec::kNumPE) done_toggle;
   
   SC_HAS_PROCESS(PEDone);
   PEDone(sc_module_name name)
      : sc_module(name), 
      clk("clk"), 
-     rst("rst")
+     rst("rst"),
+     pe_group("pe_group"),
+     pe_start_toggle("pe_start_toggle"),
+     pe_done_toggle("pe_done_toggle"),
+     pe_done_status("pe_done_status"),
+     pe_done_overflow("pe_done_overflow")
   {
   
     SC_THREAD(RecvPEDone);
@@ -149,35 +167,89 @@ SC_MODULE(PEDone) {
     }
     trigger.ResetWrite();  
     done_indicator = 0;
+    done_toggle = 0;
+    done_overflow = 0;
+    running = 0;
+    spec::PEMaskType start_toggle_seen = 0;
+    #pragma hls_unroll yes    
+    for (int i = 0; i < spec::kNumPE; i++) {
+      done_count[i] = 0;
+    }
+    pe_done_toggle.write(0);
+    pe_done_status.write(0);
+    pe_done_overflow.write(0);
 
     #pragma hls_pipeline_init_interval 1
     while(1) {
+      // PEStart starts a PE at most once until its done, which comes at least 
+      //   a cycle after the start, the toggle read here has already flipped by then
+      spec::PEMaskType start_toggle_reg = pe_start_toggle.read();
+      running |= start_toggle_reg ^ start_toggle_seen;
+      start_toggle_seen = start_toggle_reg;
       #pragma hls_unroll yes
       for (int i = 0; i < spec::kNumPE; i++) {
         bool done_reg = 0;
-        done_indicator[i] = done_indicator[i] | pe_done_array[i].PopNB(done_reg);
+        if (pe_done_array[i].PopNB(done_reg) && running[i]) {
+          running[i] = 0;
+          if (done_count[i] != 3) done_count[i] += 1;
+          else done_overflow[i] = 1;
+          done_toggle[i] = !done_toggle[i];
+        }
+        done_indicator[i] = (done_count[i] != 0);
       }      
       
-      if (done_indicator.and_reduce()) {
-        done_indicator = 0;
-        trigger.Push(1);
+      // one barrier per PE group (a group without PEs never finishes), 
+      //   at most one group triggered per cycle
+      spec::PEMaskType pe_group_reg = pe_group.read();
+      bool is_trigger = 0;
+      spec::PEGroupType trigger_group = 0;
+      NVUINTW(spec::kNumPE) trigger_mask = 0;
+      #pragma hls_unroll yes
+      for (int g = 0; g < spec::kNumPEGroups; g++) {
+        NVUINTW(spec::kNumPE) group_mask = 0;
+        #pragma hls_unroll yes
+        for (int i = 0; i < spec::kNumPE; i++) {
+          group_mask[i] = (pe_group_reg[i] == g);
+        }
+        if (!is_trigger && group_mask.or_reduce() && ((done_indicator & group_mask) == group_mask)) {
+          is_trigger = 1;
+          trigger_group = g;
+          trigger_mask = group_mask;
+        }
       }
       
+      if (is_trigger) {
+        done_indicator &= ~trigger_mask;
+        #pragma hls_unroll yes
+        for (int i = 0; i < spec::kNumPE; i++) {
+          if (trigger_mask[i]) done_count[i] -= 1;
+        }
+        trigger.Push(trigger_group);
+      }
+      
+      pe_done_toggle.write(done_toggle);
+      pe_done_status.write(done_indicator);
+      pe_done_overflow.write(done_overflow);
+      
       wait();
     }
   }
   void SendAllDone() {
     trigger.ResetRead();
-    all_pe_done.Reset();
+    #pragma hls_unroll yes    
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      all_pe_done[g].Reset();
+    }
 
     #pragma hls_pipeline_init_interval 1    
     while(1) {
-      trigger.Pop();
-      #pragma hls_pipeline_init_interval 1      
-      for (int i = 0; i < kSendDelay; i++) {
-        wait();
+      spec::PEGroupType trigger_group = trigger.Pop();
+      if (trigger_group == 0) {
+        all_pe_done[0].Push(1);
+      }
+      else {
+        all_pe_done[1].Push(1);
       }
-      all_pe_done.Push(1);
       wait();
     }
   }
@@ -192,13 +264,17 @@ SC_MODULE(GBSend) {
   
   Connections::In<spec::StreamType>   gb_output;   
   Connections::OutBuffered<spec::StreamType>  pe_inputs[spec::kNumPE];
+  Connections::In<bool>               all_pe_start[spec::kNumPEGroups];  // from GB, after its beats
+  Connections::Out<bool>              pe_start_out[spec::kNumPE];        // to PEStart
+  sc_in<spec::PEMaskType>             pe_group;   // PE group of each PE
  
   // note: does not give the name for I/O connections
   SC_HAS_PROCESS(GBSend);
   GBSend(sc_module_name name)
      : sc_module(name), 
      clk("clk"), 
-     rst("rst")
+     rst("rst"),
+     pe_group("pe_group")
   {
   
     SC_THREAD(Run);
@@ -212,7 +288,16 @@ SC_MODULE(GBSend) {
     #pragma hls_unroll yes    
     for (int i = 0; i < spec::kNumPE; i++) {
       pe_inputs[i].Reset();
+      pe_start_out[i].Reset();
     }
+    #pragma hls_unroll yes    
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      all_pe_start[g].Reset();
+    }
+    
+    spec::StreamType gb_output_reg;
+    bool is_valid = 0;
+    spec::PEMaskType start_pending = 0;   // start of PE i waits for the beats before it
     
     #pragma hls_pipeline_init_interval 2
     while (1) {
@@ -221,18 +306,62 @@ SC_MODULE(GBSend) {
       for (int i = 0; i < spec::kNumPE; i++) {
         pe_inputs[i].TransferNB();
       }
-      NVUINTW(spec::kNumPE) is_full_array = 0;       
-      #pragma hls_unroll yes
-      for (int i = 0; i < spec::kNumPE; i++) {
-        is_full_array[i] = pe_inputs[i].Full();      
-      }
-      if (!is_full_array.or_reduce()) {
-        spec::StreamType gb_output_reg;
-        if (gb_output.PopNB(gb_output_reg)) {
+      // The data is sent to the PEs of pe_mask (unicast/multicast), or to all PEs 
+      //   of its group if pe_mask is 0, so only those PEs can stall it,
+      //   a PE with a pending start takes no beat, the beats after a start wait for it
+      if (is_valid) {
+        spec::PEMaskType pe_group_reg = pe_group.read();
+        spec::PEMaskType dest_mask = gb_output_reg.pe_mask;
+        if (dest_mask == 0) {
+          #pragma hls_unroll yes
+          for (int i = 0; i < spec::kNumPE; i++) {
+            dest_mask[i] = (pe_group_reg[i] == gb_output_reg.group);
+          }
+        }
+        NVUINTW(spec::kNumPE) is_full_array = 0;       
+        #pragma hls_unroll yes
+        for (int i = 0; i < spec::kNumPE; i++) {
+          is_full_array[i] = dest_mask[i] && (pe_inputs[i].Full() || start_pending[i]);
+        }
+        if (!is_full_array.or_reduce()) {
           #pragma hls_unroll yes    
           for (int i = 0; i < spec::kNumPE; i++) {
-            pe_inputs[i].Push(gb_output_reg);
+            if (dest_mask[i]) {
+              pe_inputs[i].Push(gb_output_reg);
+            }
+          }
+          is_valid = 0;
+        }
+      }
+      if (!is_valid) {
+        is_valid = gb_output.PopNB(gb_output_reg);
+      }
+      
+      // a start follows the beats streamed before it, so it is taken in a cycle without beat,
+      //   and only once the previous start of its PEs has been passed on
+      if (!is_valid) {
+        spec::PEMaskType pe_group_reg = pe_group.read();
+        bool is_start = 0;
+        #pragma hls_unroll yes
+        for (int g = 0; g < spec::kNumPEGroups; g++) {
+          spec::PEMaskType group_mask = 0;
+          #pragma hls_unroll yes
+          for (int i = 0; i < spec::kNumPE; i++) {
+            group_mask[i] = (pe_group_reg[i] == g);
           }
+          bool all_pe_start_reg;
+          if (!is_start && ((start_pending & group_mask) == 0) && all_pe_start[g].PopNB(all_pe_start_reg)) {
+            is_start = 1;
+            start_pending |= group_mask;
+          }
+        }
+      }
+      
+      // the beats before the start have left the output buffer of PE i (taken by the PE)
+      #pragma hls_unroll yes
+      for (int i = 0; i < spec::kNumPE; i++) {
+        if (start_pending[i] && pe_inputs[i].Empty() && pe_start_out[i].PushNB(1)) {
+          start_pending[i] = 0;
         }
       }
       wait();
@@ -266,6 +395,9 @@ class GBRecv : public match::Module {
  public:
   Connections::In<DataType>     data_in[NumInputs];
   Connections::Out<DataType>    data_out[NumOutputs];
+  Connections::In<bool>         pe_done_in[NumInputs];    // from the PEs
+  Connections::Out<bool>        pe_done_out[NumInputs];   // to PEDone, after the outputs before it
+  sc_in<spec::PEMaskType>       pe_group;   // tags each PE output with the group of the PE
 
   ArbitratedCrossbar<DataType, NumInputs, NumOutputs, LenInputBuffer, LenOutputBuffer> arbxbar;
 
@@ -291,6 +423,14 @@ class GBRecv : public match::Module {
     for(int out_lane=0; out_lane<NumOutputs; out_lane++) {
       data_out[out_lane].Reset();
     }
+    
+    bool done_held[NumInputs];   // done of PE i taken, its outputs still in the crossbar
+    #pragma hls_unroll yes
+    for(int inp_lane=0; inp_lane<NumInputs; inp_lane++) {
+      pe_done_in[inp_lane].Reset();
+      pe_done_out[inp_lane].Reset();
+      done_held[inp_lane] = 0;
+    }
 
     #pragma hls_pipeline_init_interval 1
     while(1) {
@@ -306,12 +446,21 @@ class GBRecv : public match::Module {
 	dest_in_reg[inp_lane]  = 0;
         if(!arbxbar.isInputFull(inp_lane) && LenInputBuffer > 0) {
 	        valid_in_reg[inp_lane] = data_in[inp_lane].PopNB(data_in_reg[inp_lane]);
+	        data_in_reg[inp_lane].group = nvhls::get_slc<1>(pe_group.read(), inp_lane);
+	        data_in_reg[inp_lane].pe_src = 0;
+	        data_in_reg[inp_lane].pe_src[inp_lane] = 1;
 	        //data_in_reg[inp_lane]  = static_cast<DataType>   (data_dest_in_reg[inp_lane]);
 	        // only 1 output: idx = 0 	        
 	        //dest_in_reg[inp_lane]  = 0;
 	        //static_cast<OutIdxType> (data_dest_in_reg[inp_lane] >> Wrapped<DataType>::width);
         } else {
           valid_in_reg[inp_lane] = false;
+        }
+        // a PE may push its last output and its done in the same cycle, 
+        //   the done is only taken in a cycle without output of that PE
+        bool pe_done_reg;
+        if (!done_held[inp_lane] && !valid_in_reg[inp_lane] && !arbxbar.isInputFull(inp_lane)) {
+          done_held[inp_lane] = pe_done_in[inp_lane].PopNB(pe_done_reg);
         }
           T(2) << "data_in["   << inp_lane << "] = " << data_in_reg[inp_lane]
                << " dest_in["  << inp_lane << "] = " << dest_in_reg[inp_lane]
@@ -335,6 +484,15 @@ class GBRecv : public match::Module {
           T(2) << "data_out[" << out_lane << "] = " << data_out_reg[out_lane] << EndT;
         }
       }
+      
+      // after the pushes, an output is pending until GB has taken it
+      #pragma hls_unroll yes
+      for(int inp_lane=0; inp_lane<NumInputs; inp_lane++) {
+        if (done_held[inp_lane] && arbxbar.isInputEmpty(inp_lane) && arbxbar.isOutputEmpty(0) &&
+            pe_done_out[inp_lane].PushNB(1)) {
+          done_held[inp_lane] = 0;
+        }
+      }
     }
   }  
 };
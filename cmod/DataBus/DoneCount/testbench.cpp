@@ -0,0 +1,154 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "DataBus/DataBus.h"
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+
+// PEDone done_count overflow: PEs 0 and 1 are group 0 (PEs 2 to 7 group 1, never done).
+//   PE 0 is started and done kNumDone times while PE 1 is not done, the done after 
+//   kMaxDoneCount does not fit done_count and must set pe_done_overflow of PE 0 only.
+//   Then PE 1 is done once, the group is done once, and the flag stays set
+
+const unsigned kMaxDoneCount = 3;     // NVUINT2 done_count of PEDone
+const unsigned kNumDone      = kMaxDoneCount + 1;
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<bool> pe_done_recv[spec::kNumPE];
+  Connections::Combinational<bool> all_pe_done[spec::kNumPEGroups];
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_start_toggle;
+  sc_signal<spec::PEMaskType>      pe_done_toggle;
+  sc_signal<spec::PEMaskType>      pe_done_status;
+  sc_signal<spec::PEMaskType>      pe_done_overflow;
+
+  PEDone  pe_done_inst;
+
+  bool     is_finished;
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    pe_done_inst("pe_done_inst")
+  {
+    is_finished = 0;
+
+    pe_done_inst.clk(clk);
+    pe_done_inst.rst(rst);
+    for (int i = 0; i < spec::kNumPE; i++) {
+      pe_done_inst.pe_done_array[i](pe_done_recv[i]);
+    }
+    pe_done_inst.pe_group(pe_group);
+    pe_done_inst.pe_start_toggle(pe_start_toggle);
+    pe_done_inst.pe_done_toggle(pe_done_toggle);
+    pe_done_inst.pe_done_status(pe_done_status);
+    pe_done_inst.pe_done_overflow(pe_done_overflow);
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      pe_done_inst.all_pe_done[g](all_pe_done[g]);
+    }
+
+    SC_THREAD(Drive);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+
+    SC_THREAD(run);
+  }
+
+  // start PE i (as PEStart does), then push its done
+  void StartDone(spec::PEMaskType& start_toggle, const unsigned i) {
+    start_toggle[i] = !start_toggle[i];
+    pe_start_toggle.write(start_toggle);
+    wait(2);
+    pe_done_recv[i].Push(1);
+    wait(2);
+  }
+
+  void Drive() {
+    for (int i = 0; i < spec::kNumPE; i++) {
+      pe_done_recv[i].ResetWrite();
+    }
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      all_pe_done[g].ResetRead();
+    }
+    spec::PEMaskType start_toggle = 0;
+    pe_start_toggle.write(start_toggle);
+    pe_group.write(0xFC);
+    wait();
+
+    for (unsigned n = 0; n < kNumDone; n++) {
+      StartDone(start_toggle, 0);
+      cout << sc_time_stamp() << " PE 0 done " << n + 1 << ", pe_done_overflow " 
+           << pe_done_overflow.read() << endl;
+      assert(pe_done_status.read() == 0x01);
+      assert(pe_done_overflow.read() == ((n < kMaxDoneCount) ? 0x00 : 0x01));
+    }
+    bool done_reg;
+    assert(!all_pe_done[0].PopNB(done_reg));
+
+    StartDone(start_toggle, 1);
+    done_reg = all_pe_done[0].Pop();
+    wait(2);
+    // PE 0 still counts kMaxDoneCount - 1 timesteps ahead, the lost done is not back
+    assert(pe_done_status.read() == 0x01);
+    assert(pe_done_overflow.read() == 0x01);
+    assert(!all_pe_done[1].PopNB(done_reg));
+
+    is_finished = 1;
+    cout << sc_time_stamp() << " done count checks passed" << endl;
+    while (1) wait();
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(1000, SC_NS );
+    assert(is_finished);
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+};
+
+int sc_main(int argc, char *argv[]) {
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
@@ -0,0 +1,319 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "DataBus/DataBus.h"
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+
+// Start/done ordering of GBSend, PEStart, GBRecv and PEDone with all PEs in group 0:
+//   GB streams kNumInput beats then the group start, every PE checks it got all
+//   inputs when started, then pushes kNumOutput outputs, the last one in the same cycle
+//   as its done. GB takes one output every kRecvInterval cycles, so outputs wait in GBRecv
+//   while the dones are there, and checks that all outputs of a PE have been received
+//   when it reports that PE done (pe_done_status) and when the group is done.
+//   Before that, every PE pushes kNumAxiDone dones as if started over its own AXI,
+//   which must neither finish the group nor keep the PEs from being started
+
+const unsigned kNumInput     = 2;
+const unsigned kNumOutput    = 3;
+const unsigned kNumTimestep  = 3;
+const unsigned kRecvInterval = 3;
+const unsigned kNumAxiDone   = 5;     // more than done_count of PEDone holds
+const unsigned kIdleCycles   = 100;   // GB waits for the dones of the AXI runs
+
+SC_MODULE(PE) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::In<spec::StreamType>  input_port;
+  Connections::In<bool>              start;
+  Connections::Out<spec::StreamType> output_port;
+  Connections::Out<bool>             done;
+
+  unsigned id;
+  unsigned num_input;
+  unsigned num_start;
+  sc_signal<bool> is_last;   // written the cycle before the last output, pushes the done with it
+
+  SC_HAS_PROCESS(PE);
+  PE(sc_module_name name, const unsigned id_)
+  : sc_module(name), id(id_) {
+    SC_THREAD(InputRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+
+    SC_THREAD(OutputRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+
+    SC_THREAD(DoneRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void InputRun() {
+    input_port.Reset();
+    num_input = 0;
+    wait();
+    while (1) {
+      spec::StreamType input_reg;
+      if (input_port.PopNB(input_reg)) {
+        num_input++;
+      }
+      wait();
+    }
+  }
+
+  void OutputRun() {
+    start.Reset();
+    output_port.Reset();
+    num_start = 0;
+    is_last.write(0);
+    wait();
+    while (1) {
+      start.Pop();
+      num_start++;
+      // the inputs streamed before the start have all arrived
+      assert(num_input == kNumInput*num_start);
+      wait(id + 1);
+      for (unsigned o = 0; o < kNumOutput; o++) {
+        if (o == kNumOutput - 1) {
+          is_last.write(1);
+          wait();
+          is_last.write(0);
+        }
+        spec::StreamType output_reg;
+        output_reg.data[0] = id;
+        output_reg.logical_addr = o;
+        output_port.Push(output_reg);
+      }
+    }
+  }
+
+  void DoneRun() {
+    done.Reset();
+    wait();
+    for (unsigned i = 0; i < kNumAxiDone; i++) {
+      done.Push(1);
+    }
+    while (1) {
+      if (is_last.read()) {
+        done.Push(1);
+      }
+      wait();
+    }
+  }
+};
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<spec::StreamType> gb_output;
+  Connections::Combinational<spec::StreamType> pe_inputs[spec::kNumPE];
+  Connections::Combinational<spec::StreamType> pe_outputs[spec::kNumPE];
+  Connections::Combinational<spec::StreamType> gb_input;
+  Connections::Combinational<bool> all_pe_start[spec::kNumPEGroups];
+  Connections::Combinational<bool> pe_start_sent[spec::kNumPE];
+  Connections::Combinational<bool> pe_start_array[spec::kNumPE];
+  Connections::Combinational<bool> pe_done_array[spec::kNumPE];
+  Connections::Combinational<bool> pe_done_recv[spec::kNumPE];
+  Connections::Combinational<bool> all_pe_done[spec::kNumPEGroups];
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_start_toggle;
+  sc_signal<spec::PEMaskType>      pe_done_toggle;
+  sc_signal<spec::PEMaskType>      pe_done_status;
+  sc_signal<spec::PEMaskType>      pe_done_overflow;
+
+  PEStart pe_start_inst;
+  PEDone  pe_done_inst;
+  GBSend  gb_send_inst;
+  GBRecv  gb_recv_inst;
+  PE*     pe_ptrs[spec::kNumPE];
+
+  unsigned num_recv[spec::kNumPE];   // outputs of each PE received by GB
+  bool     is_finished;
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    pe_start_inst("pe_start_inst"),
+    pe_done_inst("pe_done_inst"),
+    gb_send_inst("gb_send_inst"),
+    gb_recv_inst("gb_recv_inst")
+  {
+    for (int i = 0; i < spec::kNumPE; i++) {
+      pe_ptrs[i] = new PE(sc_gen_unique_name("pe_inst"), i);
+      pe_ptrs[i]->clk(clk);
+      pe_ptrs[i]->rst(rst);
+      pe_ptrs[i]->input_port(pe_inputs[i]);
+      pe_ptrs[i]->start(pe_start_array[i]);
+      pe_ptrs[i]->output_port(pe_outputs[i]);
+      pe_ptrs[i]->done(pe_done_array[i]);
+    }
+
+    pe_start_inst.clk(clk);
+    pe_start_inst.rst(rst);
+    pe_start_inst.pe_done_toggle(pe_done_toggle);
+    pe_start_inst.pe_start_toggle(pe_start_toggle);
+    for (int i = 0; i < spec::kNumPE; i++) {
+      pe_start_inst.pe_start_in[i](pe_start_sent[i]);
+      pe_start_inst.pe_start_array[i](pe_start_array[i]);
+    }
+
+    pe_done_inst.clk(clk);
+    pe_done_inst.rst(rst);
+    for (int i = 0; i < spec::kNumPE; i++) {
+      pe_done_inst.pe_done_array[i](pe_done_recv[i]);
+    }
+    pe_done_inst.pe_group(pe_group);
+    pe_done_inst.pe_start_toggle(pe_start_toggle);
+    pe_done_inst.pe_done_toggle(pe_done_toggle);
+    pe_done_inst.pe_done_status(pe_done_status);
+    pe_done_inst.pe_done_overflow(pe_done_overflow);
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      pe_done_inst.all_pe_done[g](all_pe_done[g]);
+    }
+
+    gb_send_inst.clk(clk);
+    gb_send_inst.rst(rst);
+    gb_send_inst.gb_output(gb_output);
+    gb_send_inst.pe_group(pe_group);
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      gb_send_inst.all_pe_start[g](all_pe_start[g]);
+    }
+    for (int i = 0; i < spec::kNumPE; i++) {
+      gb_send_inst.pe_inputs[i](pe_inputs[i]);
+      gb_send_inst.pe_start_out[i](pe_start_sent[i]);
+    }
+
+    gb_recv_inst.clk(clk);
+    gb_recv_inst.rst(rst);
+    for (int i = 0; i < spec::kNumPE; i++) {
+      gb_recv_inst.data_in[i](pe_outputs[i]);
+      gb_recv_inst.pe_done_in[i](pe_done_array[i]);
+      gb_recv_inst.pe_done_out[i](pe_done_recv[i]);
+    }
+    gb_recv_inst.data_out[0](gb_input);
+    gb_recv_inst.pe_group(pe_group);
+
+    SC_THREAD(GBSendRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+
+    SC_THREAD(GBRecvRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+
+    SC_THREAD(run);
+  }
+
+  // GB side: inputs then start of each timestep, next timestep after the group done
+  void GBSendRun() {
+    gb_output.ResetWrite();
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      all_pe_start[g].ResetWrite();
+      all_pe_done[g].ResetRead();
+    }
+    pe_group.write(0);
+    is_finished = 0;
+    wait(kIdleCycles);
+    bool all_pe_done_reg;
+    assert(!all_pe_done[0].PopNB(all_pe_done_reg));
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < kNumInput; v++) {
+        spec::StreamType gb_output_reg;
+        gb_output_reg.logical_addr = v;
+        gb_output_reg.group = 0;
+        gb_output_reg.pe_mask = 0;
+        gb_output.Push(gb_output_reg);
+      }
+      all_pe_start[0].Push(1);
+      all_pe_done[0].Pop();
+      for (int i = 0; i < spec::kNumPE; i++) {
+        assert(num_recv[i] == kNumOutput*(t+1));
+      }
+      cout << sc_time_stamp() << " timestep " << t << " done" << endl;
+    }
+    is_finished = 1;
+    while (1) wait();
+  }
+
+  // GB side: slow output sink, a PE reported done has all its outputs received
+  void GBRecvRun() {
+    gb_input.ResetRead();
+    for (int i = 0; i < spec::kNumPE; i++) {
+      num_recv[i] = 0;
+    }
+    unsigned cycle = 0;
+    wait();
+    while (1) {
+      spec::StreamType gb_input_reg;
+      if (((++cycle % kRecvInterval) == 0) && gb_input.PopNB(gb_input_reg)) {
+        unsigned id = gb_input_reg.data[0];
+        assert(gb_input_reg.group == 0);
+        assert(gb_input_reg.pe_src[id] == 1);
+        assert(gb_input_reg.logical_addr == (num_recv[id] % kNumOutput));
+        num_recv[id]++;
+      }
+      spec::PEMaskType pe_done_status_reg = pe_done_status.read();
+      for (int i = 0; i < spec::kNumPE; i++) {
+        if (pe_done_status_reg[i]) {
+          assert((pe_ptrs[i]->num_start > 0) && (num_recv[i] == kNumOutput*pe_ptrs[i]->num_start));
+        }
+      }
+      wait();
+    }
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(10000, SC_NS );
+    assert(is_finished);
+    assert(pe_done_overflow.read() == 0);   // the AXI dones are not counted
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+};
+
+int sc_main(int argc, char *argv[]) {
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
@@ -47,6 +47,19 @@ void Exponential (const spec::AttentionVectorType in, spec::AttentionVectorType&
   }
   out = out_tmp;  
 }
+
+// Scalar version, used to rescale the running sum of online softmax
+void SExponential (const spec::AttentionScalarType in, spec::AttentionScalarType& out) {
+  ac_fixed<spec::kAttentionWordWidth, spec::kAttentionNumInt, true, AC_TRN, AC_WRAP> in_ac; 
+  ac_fixed<spec::kAttentionWordWidth, spec::kAttentionNumInt, false, AC_TRN, AC_WRAP> out_ac;
+    
+  in_ac.set_slc(0, in);
+
+  out_ac = ac_math::ac_exp_pwl
+            <ac_fixed<spec::kAttentionWordWidth, spec::kAttentionNumInt, false, AC_TRN, AC_WRAP> >(in_ac);
+
+  out.set_slc(0, nvhls::get_slc<spec::kAttentionWordWidth>(out_ac, 0));
+}
   
   
 // Now only for Attention.h (division by a scalar)
@@ -80,6 +93,7 @@ void EDiv (const spec::AttentionVectorType in_1, const spec::AttentionVectorType
   
 class Attention  : public match::Module {
   static const int softmax_index = 7;
+  static const int kMaxHeads = GBControlConfig::kMaxNumHead;
   static const int kDebugLevel = 4;
   SC_HAS_PROCESS(Attention);
  public:
@@ -92,6 +106,10 @@ class Attention  : public match::Module {
 
   Connections::Out<spec::GB::Small::DataReq>      small_req;
   Connections::In<spec::GB::Small::DataRsp>       small_rsp;
+
+  // Valid timesteps of each large buffer region (GBCore 0x4 local 0x05), written by GBRVA,
+  //   sampled at start
+  sc_in<spec::GB::Large::ValidLengthType> valid_length;
  
   // Constructor
   Attention (sc_module_name nm)
@@ -103,7 +121,8 @@ class Attention  : public match::Module {
         large_req("large_req"),
         large_rsp("large_rsp"),
         small_req("small_req"),
-        small_rsp("small_rsp")       
+        small_rsp("small_rsp"),
+        valid_length("valid_length")
   {
     SC_THREAD(AttentionRun);
     sensitive << clk.pos();
@@ -115,8 +134,6 @@ class Attention  : public match::Module {
     IDLE, 
     PRE, 
     BMM,
-    BMM1a,
-    BMM1b,
     BMM2, 
     NEXT,   // 1st bmm
     OUT,    // 2nd bmm
@@ -144,14 +161,51 @@ class Attention  : public match::Module {
   
   
   spec::AccumVectorType     accum_vector;    
-  spec::AttentionScalarType sum_exp, maximum_value;
+  // Softmax state per head (gbcontrol_config.num_head)
+  spec::AttentionScalarType sum_exp[kMaxHeads], maximum_value[kMaxHeads];
   spec::VectorType softmax_result;
   
+  // Valid encoder timesteps [range_lo, range_hi), loops start from the 16-aligned range_begin
+  //   lanes outside the range are masked (tail of num_timestep_1 not multiple of 16)
+  NVUINT16  range_lo, range_hi, range_begin;
+  // Current tile [tile_begin, tile_end), the whole range unless gbcontrol_config.is_tiled 
+  NVUINT16  tile_begin, tile_end;
+  NVUINT1   tile_phase;   // tiled: 0 global max/sum over all tiles, 1 normalize each tile 
+  
+  // Multi-head: head h covers vectors [h*num_head_vector, (h+1)*num_head_vector)
+  //   and owns score_stride entries of the softmax scratch per tile, num_head and 
+  //   num_tile_timestep keep all heads within the 8-bit scratch index 
+  //   (GBControlConfig::SetNumHead, SetTileTimestep)
+  NVUINT3   head_counter;
+  NVUINT8   head_vector_counter;
+  NVUINT8   num_head_vector;
+  NVUINT4   num_head;
+  NVUINT8   score_stride;
+  
+  // Alignment peak of the last run (head 0), AXI readable at local index 0x03 
+  //   (used to slide the local attention window)
+  NVUINT16                  maximum_timestep;
+  NVUINT16                  argmax_timestep;
+  spec::AttentionScalarType argmax_value;
+  
   void Reset() {
     state = IDLE;
     is_start      = 0;
     bmm_counter   = 0;
     softmax_counter  = 0;
+    range_lo      = 0;
+    range_hi      = 0;
+    range_begin   = 0;
+    tile_begin    = 0;
+    tile_end      = 0;
+    tile_phase    = 0;
+    argmax_timestep = 0;
+    argmax_value  = 0;
+    head_counter  = 0;
+    head_vector_counter = 0;
+    num_head_vector = 1;
+    num_head      = 1;
+    score_stride  = 0;
     gbcontrol_config.Reset();
     ResetPorts();
     ResetAccum();
@@ -174,8 +228,12 @@ class Attention  : public match::Module {
   }
   
   void ResetSoftmax() {
-    sum_exp = 0;
-    maximum_value = spec::kAttentionWordMin;
+    #pragma hls_unroll yes
+    for (int i = 0; i < kMaxHeads; i++) {
+      sum_exp[i] = 0;
+      maximum_value[i] = spec::kAttentionWordMin;
+    }
+    maximum_timestep = 0;
   }
      
   void DecodeAxiWrite(const spec::Axi::SlaveToRVA::Write& rva_in_reg){
@@ -195,7 +253,14 @@ class Attention  : public match::Module {
     // Set Push Response
     w_axi_rsp = 1;
     if (tmp == 0xB) {
-      gbcontrol_config.ConfigRead(local_index, rva_out_reg.data);
+      if (local_index == 0x03) {
+        rva_out_reg.data = 0;
+        rva_out_reg.data.set_slc<16>(0, argmax_timestep);
+        rva_out_reg.data.set_slc<spec::kAttentionWordWidth>(32, argmax_value);
+      }
+      else {
+        gbcontrol_config.ConfigRead(local_index, rva_out_reg.data);
+      }
     }    
   }  
   
@@ -259,21 +324,154 @@ class Attention  : public match::Module {
   }
   
 
-  void UpdateMax(const spec::AttentionVectorType attention_vector) {
+  void UpdateMax(const spec::AttentionVectorType attention_vector, const NVUINT16 timestep_base) {
     spec::AttentionScalarType new_max = spec::kAttentionWordMin;    // should not be a reg
+    NVUINT2 new_max_lane = 0;
 
     #pragma hls_unroll yes 
     for (int i=0; i< 4; i++){
       if (attention_vector[i] > new_max) {
         new_max = attention_vector[i]; 
+        new_max_lane = i;
       }
     }
        
-    if (new_max > maximum_value) {
-      maximum_value = new_max;
+    if (new_max > maximum_value[head_counter]) {
+      maximum_value[head_counter] = new_max;
+      if (head_counter == 0) {
+        maximum_timestep = timestep_base + new_max_lane;
+      }
+    }
+  }
+
+  // Online softmax (gbcontrol_config.is_online_softmax): 
+  //   sum_exp follows the running maximum, sum = sum*exp(old_max - new_max) + sum[exp(x - new_max)]
+  //   so SFM1 pass over the softmax scratch is skipped
+  void UpdateSumExp(const spec::AttentionVectorType attention_vector, const spec::AttentionScalarType old_max) {
+    spec::AttentionVectorType exp_vector;
+    spec::AttentionScalarType tmp_sum = 0, scale;
+    
+    #pragma hls_unroll yes
+    for (int i = 0; i < 4; i++) {
+      exp_vector[i] = attention_vector[i] - maximum_value[head_counter];
+    }        
+    Exponential(exp_vector, exp_vector);
+    #pragma hls_unroll yes
+    for (int i = 0; i < 4; i++) {
+      tmp_sum += exp_vector[i];
     }
+    
+    // sum_exp is still 0 before the first group, the scale does not matter there
+    SExponential(old_max - maximum_value[head_counter], scale);
+    NVINTW(2*spec::kAttentionWordWidth) sum_scaled = sum_exp[head_counter] * scale;
+    sum_scaled = sum_scaled >> spec::kAttentionNumFrac;
+    sum_exp[head_counter] = sum_scaled + tmp_sum;
   }
 
+  // Local attention: only [window_start, window_start + window_width) within num_timestep_1
+  void SetRange() {
+    // encoder timesteps past the valid length are skipped
+    gbcontrol_config.ValidLengthWrite(valid_length.read());
+    gbcontrol_config.SetTimestepBound(gbcontrol_config.memory_index_1);
+    range_lo = 0;
+    range_hi = gbcontrol_config.num_timestep_bound;
+    if (gbcontrol_config.is_window) {
+      NVUINTW(17) window_end = gbcontrol_config.window_start + gbcontrol_config.window_width;
+      range_lo = gbcontrol_config.window_start;
+      if (window_end < range_hi) {
+        range_hi = window_end;
+      }
+    }
+    range_begin = (range_lo >> 4) << 4;
+  }
+  
+  // Tiles are num_tile_timestep (multiple of 16) long, the last one ends at range_hi
+  void SetTile(const NVUINT16 begin) {
+    tile_begin = begin;
+    if (gbcontrol_config.is_tiled && ((begin + gbcontrol_config.num_tile_timestep) < range_hi)) {
+      tile_end = begin + gbcontrol_config.num_tile_timestep;
+    }
+    else {
+      tile_end = range_hi;
+    }
+    gbcontrol_config.timestep_counter = begin;
+  }
+  
+  bool IsLastTile() const {
+    return (tile_end >= range_hi);
+  }
+  
+  // Step 16 timesteps inside the current tile
+  void UpdateTileTimestep(bool& is_end) {
+    is_end = 0;
+    if ((gbcontrol_config.timestep_counter + 16) >= tile_end) {
+      is_end = 1;
+      gbcontrol_config.timestep_counter = tile_begin;
+    }
+    else {
+      gbcontrol_config.timestep_counter += 16;
+    }
+  }
+  
+  bool IsValidTimestep(const NVUINT16 timestep) const {
+    return (timestep >= range_lo) && (timestep < range_hi);
+  }
+  
+  // Scores (4 per entry) of the current tile and head
+  NVUINT8 GetScoreIndex() const {
+    NVUINT16 offset = gbcontrol_config.timestep_counter - tile_begin;
+    return head_counter*score_stride + (offset >> 2) + softmax_counter;
+  }
+  
+  // Softmax output (16 per entry) of the whole range, 
+  //   in place of the scores of the head, or after the score entries of all heads in tiled mode
+  NVUINT8 GetSoftmaxIndex() const {
+    NVUINT16 offset = gbcontrol_config.timestep_counter - range_begin;
+    NVUINT8 base = 0, stride = score_stride;
+    if (gbcontrol_config.is_tiled) {
+      base = num_head*score_stride;
+      stride = (range_hi - range_begin + 15) >> 4;
+    }
+    return base + head_counter*stride + (offset >> 4);
+  }
+  
+  void SetHead() {
+    // 1 to kMaxHeads, divides num_vector_1 (GBControlConfig::SetNumHead)
+    num_head = gbcontrol_config.num_head;
+    num_head_vector = gbcontrol_config.num_vector_1 / num_head;
+    head_counter = 0;
+    head_vector_counter = 0;
+    if (gbcontrol_config.is_tiled) {
+      score_stride = gbcontrol_config.num_tile_timestep >> 2;
+    }
+    else {
+      score_stride = ((range_hi - range_begin + 15) >> 4) << 2;
+    }
+  }
+  
+  // Step one vector inside the current head
+  void UpdateHeadVector(bool& is_end) {
+    is_end = 0;
+    if (head_vector_counter >= (num_head_vector - 1)) {
+      is_end = 1;
+      head_vector_counter = 0;
+    }
+    else {
+      head_vector_counter += 1;
+    }
+  }
+  
+  void UpdateHead(bool& is_end) {
+    is_end = 0;
+    if (head_counter >= (num_head - 1)) {
+      is_end = 1;
+      head_counter = 0;
+    }
+    else {
+      head_counter += 1;
+    }
+  }
+  
   void UpdateSoftmaxCounter(bool & is_end) {
     if (softmax_counter == 3) { 
       is_end = 1;
@@ -307,10 +505,11 @@ class Attention  : public match::Module {
       }
       case BMM: {
         // Read Small, Large
-        // Make sure the cycle behavior is correct, and no deadlock
+        // Large and small buffer requests are served by separate GBCore threads, 
+        //   both are sent in the same cycle and popped in BMM2
         NVUINT3   memory_index_encoder = gbcontrol_config.memory_index_1;
-        //NVUINT3   memory_index_decoder = gbcontrol_config.memory_index_2;
-        //NVUINT3   memory_index_softmax = softmax_index; // 7
+        NVUINT3   memory_index_decoder = gbcontrol_config.memory_index_2;
+        NVUINT3   memory_index_softmax = softmax_index; // 7
         NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
         NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
         
@@ -320,17 +519,7 @@ class Attention  : public match::Module {
         large_req_reg.vector_index = vector_index;
         large_req_reg.timestep_index = timestep_index;
         large_req.Push(large_req_reg);
-        break;
-      }
-      case BMM1a: {
-        large_rsp_reg = large_rsp.Pop();
-        break;
-      }
-      case BMM1b: { 
-        NVUINT3   memory_index_decoder = gbcontrol_config.memory_index_2;
-        NVUINT3   memory_index_softmax = softmax_index; // 7
-        NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
-        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
+        
         small_req_reg.is_write = 0;
         if (bmm_counter == 0) {
           small_req_reg.memory_index = memory_index_decoder;
@@ -338,13 +527,13 @@ class Attention  : public match::Module {
         }
         else {
           small_req_reg.memory_index = memory_index_softmax;
-          small_req_reg.vector_index = timestep_index >> 4;     
+          small_req_reg.vector_index = GetSoftmaxIndex();     
         }
         small_req.Push(small_req_reg);
         break;
       }
       case BMM2: { 
-        //large_rsp_reg = large_rsp.Pop();        
+        large_rsp_reg = large_rsp.Pop();        
         small_rsp_reg = small_rsp.Pop(); 
         
         spec::VectorType dp_in0[spec::kNumVectorLanes];
@@ -391,24 +580,34 @@ class Attention  : public match::Module {
         // We assume that the output of first BMM is extremely likely not to be zero if it is not the zeropadded outputs
         // Therefore, to solve the problem of zeropadded outputs, we could set them to a very high negative value
         
+        // Timesteps outside of the valid range are masked the same way
         #pragma hls_unroll yes          
         for (int j = 0; j < 4; j++) {
+          NVUINT16 lane_timestep = timestep_index + 4*softmax_counter + j;
           // XXX changes based on the above reasoning, we set the zero outputs to -64
-          if (attention_vector[j] == 0) {
+          if ((attention_vector[j] == 0) || !IsValidTimestep(lane_timestep)) {
             attention_vector[j] = -64*(1<<spec::kAttentionNumFrac);
           }
           else {
             attention_vector[j] = attention_vector[j] >> shift_amount;         
           }
         }
-        UpdateMax(attention_vector);
+
+        // tiled: max/sum only in the first pass over the tiles, the second pass recomputes the scores
+        if (!gbcontrol_config.is_tiled || (tile_phase == 0)) {
+          spec::AttentionScalarType old_max = maximum_value[head_counter];
+          UpdateMax(attention_vector, timestep_index + 4*softmax_counter);
+          if (gbcontrol_config.is_online_softmax || gbcontrol_config.is_tiled) {
+            UpdateSumExp(attention_vector, old_max);
+          }
+        }
           
         // Output follows the timestep_index with basic unit 16 
         spec::VectorType tmp_data(attention_vector.to_rawbits());
           
         small_req_reg.is_write = 1;        
         small_req_reg.memory_index = softmax_index;
-        small_req_reg.vector_index = (timestep_index >> 2) + softmax_counter;                                 
+        small_req_reg.vector_index = GetScoreIndex();                                 
         small_req_reg.write_data = tmp_data;
         small_req.Push(small_req_reg);
         
@@ -445,13 +644,12 @@ class Attention  : public match::Module {
         break;
       }
       case SFM1: {
-        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
         //spec::AttentionVectorType maximum_vector;
         //spec::AttentionScalarType tmp_sum = 0;
         
         small_req_reg.is_write = 0;        
         small_req_reg.memory_index = softmax_index;        
-        small_req_reg.vector_index = (timestep_index >> 2) + softmax_counter;        
+        small_req_reg.vector_index = GetScoreIndex();        
         small_req.Push(small_req_reg);                
         break;
       }
@@ -463,7 +661,7 @@ class Attention  : public match::Module {
                 
         #pragma hls_unroll yes
         for (int i = 0; i < 4; i++) {
-          exp_vector[i] -= maximum_value;
+          exp_vector[i] -= maximum_value[head_counter];
         }        
         Exponential(exp_vector, exp_vector);
         
@@ -471,21 +669,21 @@ class Attention  : public match::Module {
         for (int i = 0; i < 4; i++) {
           tmp_sum += exp_vector[i];
         }             
-        sum_exp += tmp_sum;
+        sum_exp[head_counter] += tmp_sum;
         break;
       }
       case SFM2: {
-        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
         //spec::AttentionVectorType maximum_vector;
         //spec::AttentionVectorType sum_exp_vector;
         
         small_req_reg.is_write = 0;        
         small_req_reg.memory_index = softmax_index;        
-        small_req_reg.vector_index = (timestep_index >> 2) + softmax_counter;        
+        small_req_reg.vector_index = GetScoreIndex();        
         small_req.Push(small_req_reg);                
         break;
       }
       case SFM2b: {
+        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
         spec::AttentionVectorType sum_exp_vector; 
         small_rsp_reg = small_rsp.Pop();         
         
@@ -493,8 +691,8 @@ class Attention  : public match::Module {
                 
         #pragma hls_unroll yes
         for (int i = 0; i < 4; i++) {
-          exp_vector[i] -= maximum_value;
-          sum_exp_vector[i] = sum_exp;
+          exp_vector[i] -= maximum_value[head_counter];
+          sum_exp_vector[i] = sum_exp[head_counter];
         }        
         Exponential(exp_vector, exp_vector); 
         
@@ -507,22 +705,30 @@ class Attention  : public match::Module {
           NVINTW(26) reduce = exp_vector[i];
           // compress softmax output
           tmp.set_value_fixed<26, spec::kAttentionNumFrac>(reduce, adpbias_softmax);
-          softmax_result[i + 4*softmax_counter] = tmp.to_rawbits();
+          // masked timesteps do not contribute to BMM2
+          NVUINT16 lane_timestep = timestep_index + 4*softmax_counter + i;
+          if (IsValidTimestep(lane_timestep)) {
+            softmax_result[i + 4*softmax_counter] = tmp.to_rawbits();
+          }
+          else {
+            softmax_result[i + 4*softmax_counter] = 0;
+          }
         }
         break;
       }
       case SFM3: {
-        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();      
         small_req_reg.is_write = 1;        
         small_req_reg.write_data = softmax_result;
 
         small_req_reg.memory_index = softmax_index;        
-        small_req_reg.vector_index = (timestep_index >> 4);        
+        small_req_reg.vector_index = GetSoftmaxIndex();        
         small_req.Push(small_req_reg);                
         
         break;
       }      
       case FIN: {
+        argmax_timestep = maximum_timestep;
+        argmax_value = maximum_value[0];
         done.Push(1);
         CDCOUT(sc_time_stamp() << name() << " Attention Finish " << endl, kDebugLevel);
         break;
@@ -538,6 +744,10 @@ class Attention  : public match::Module {
     switch (state) {
       case IDLE: {
         if (is_start) {
+          SetRange();
+          SetTile(range_begin);
+          SetHead();
+          tile_phase = 0;
           next_state = PRE;
         }
         else {
@@ -550,21 +760,16 @@ class Attention  : public match::Module {
         break;
       }
       case BMM: {
-        next_state = BMM1a;
-        break;
-      }
-      case BMM1a: {
-        next_state = BMM1b;
-        break;
-      }
-      case BMM1b: {
         next_state = BMM2;
         break;
       }
       case BMM2: {
         bool is_end = 0;
         if (bmm_counter == 0) {
-          gbcontrol_config.UpdateVectorCounter(is_end);
+          // vector_counter runs over all heads, NEXT after the vectors of each head
+          bool is_all_end = 0;
+          gbcontrol_config.UpdateVectorCounter(is_all_end);
+          UpdateHeadVector(is_end);
           if (is_end) {
             next_state = NEXT;
           }
@@ -573,7 +778,7 @@ class Attention  : public match::Module {
           }
         }
         else {
-          gbcontrol_config.UpdateTimestepCounterBySixteen(is_end);
+          UpdateTileTimestep(is_end);
           if (is_end) {
             next_state = OUT;
           }
@@ -589,13 +794,33 @@ class Attention  : public match::Module {
       case NEXT: {
         // work only for first BMM
         // softmax_counter
-        bool is_end1 = 0, is_end2 = 0;
+        bool is_end1 = 0, is_end2 = 0, is_head_end = 0;
         UpdateSoftmaxCounter(is_end1);
         if (is_end1) {
-          gbcontrol_config.UpdateTimestepCounterBySixteen(is_end2);
+          UpdateHead(is_head_end);
+        }
+        if (is_end1 && !is_head_end) {
+          // same timesteps for the next head
+          next_state = PRE;
+        }
+        else if (is_end1) {
+          UpdateTileTimestep(is_end2);
           if (is_end2) {
-            next_state = SFM1;
-            bmm_counter = 1;
+            if (gbcontrol_config.is_tiled && (tile_phase == 0)) {
+              // global max/sum after the last tile, then recompute scores tile by tile
+              if (IsLastTile()) {
+                tile_phase = 1;
+                SetTile(range_begin);
+              }
+              else {
+                SetTile(tile_end);
+              }
+              next_state = PRE;
+            }
+            else {
+              // online softmax already has sum[exp], only the normalization pass remains
+              next_state = (gbcontrol_config.is_online_softmax || gbcontrol_config.is_tiled) ? SFM2 : SFM1;
+            }
           }
           else {
             next_state = PRE;         
@@ -612,8 +837,13 @@ class Attention  : public match::Module {
         // work only for second BMM
         // update vector_counter
         // push output 
-        bool is_end = 0;
+        bool is_end = 0, is_head_end = 0, is_dummy = 0;
         gbcontrol_config.UpdateVectorCounter(is_end);
+        // keep head_counter on the head of the output vector for the softmax read
+        UpdateHeadVector(is_head_end);
+        if (is_head_end) {
+          UpdateHead(is_dummy);
+        }
         if (is_end) {
           next_state = FIN;
           bmm_counter = 0;
@@ -633,7 +863,7 @@ class Attention  : public match::Module {
         bool is_end1 = 0, is_end2 = 0;
         UpdateSoftmaxCounter(is_end1);
         if (is_end1) {
-          gbcontrol_config.UpdateTimestepCounterBySixteen(is_end2);
+          UpdateTileTimestep(is_end2);
           if (is_end2) {
             next_state = SFM2;
           }
@@ -668,10 +898,26 @@ class Attention  : public match::Module {
       case SFM3: {
         // Write SFM output to SRAM
         // update timestep_counter by 16 (4 reads 1 write)        
-        bool is_end = 0;        
-        gbcontrol_config.UpdateTimestepCounterBySixteen(is_end);
+        bool is_end = 0, is_head_end = 0;        
+        UpdateTileTimestep(is_end);
         if (is_end) {
-          bmm_counter = 1;        
+          UpdateHead(is_head_end);
+        }
+        if (is_end && !is_head_end) {
+          // softmax of the next head over the same tile
+          next_state = (gbcontrol_config.is_online_softmax || gbcontrol_config.is_tiled) ? SFM2 : SFM1;
+        }
+        else if (is_end) {
+          if (gbcontrol_config.is_tiled && !IsLastTile()) {
+            SetTile(tile_end);
+          }
+          else {
+            // BMM2 over the whole range
+            bmm_counter = 1;        
+            tile_begin = range_begin;
+            tile_end = range_hi;
+            gbcontrol_config.timestep_counter = range_begin;
+          }
           next_state = PRE;
         }
         else {
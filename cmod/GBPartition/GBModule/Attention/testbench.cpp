@@ -505,6 +505,7 @@ SC_MODULE(testbench) {
   Connections::Combinational<spec::GB::Large::DataRsp<16>>    large_rsp;  
   Connections::Combinational<spec::GB::Small::DataReq>      small_req;
   Connections::Combinational<spec::GB::Small::DataRsp>       small_rsp;
+  sc_signal<spec::GB::Large::ValidLengthType> valid_length;   // 0: whole region
 
   NVHLS_DESIGN(Attention) dut;
   Source  source;
@@ -528,6 +529,7 @@ SC_MODULE(testbench) {
     dut.large_rsp(large_rsp);
     dut.small_req(small_req);
     dut.small_rsp(small_rsp);
+    dut.valid_length(valid_length);
     
     source.clk(clk);
     source.rst(rst);
@@ -30,9 +30,14 @@
 #include "SM6Spec.h"
 #include "AxiSpec.h"
 /*
-  XXX: The current coding style of Push, Pop might not work for II = 1
-  Might need another thread for sending read request
-  Maybe use wait() between Push Pop will work
+  Streaming reads (SEND, SENDBACK, x(t+1) prefetch in RECV) keep up to 
+  kMaxOutstanding requests in flight: each cycle pops one response (PopNB) and 
+  issues one request (PushNB), so a sequence of N vectors takes about N cycles.
+  A response the stream does not take is held (return_reg) and pushed again in the 
+  next cycles (PushNB), so RECV keeps taking PE outputs while the prefetched x(t+1) 
+  waits for a PE without PEConfig.is_input_dbuf, which only takes it once done with t.
+  Issue and return stay in one thread since RECV shares large_req (GB write) 
+  and data_out (loopback) with the streaming path.
 */
 
   // GB 
@@ -56,6 +61,7 @@ class GBControl : public match::Module {
   static const int kDebugLevel = 4;
   static const int x_index = 0;
   static const int h_index = 1;    
+  static const int kMaxOutstanding = 4;
   
   SC_HAS_PROCESS(GBControl);
  public:
@@ -76,6 +82,18 @@ class GBControl : public match::Module {
   
   Connections::Out<bool> pe_start;
   Connections::In<bool>  pe_done;
+  
+  // Layer pipelining (PE groups): timesteps finished by this GBControl, 
+  //   and by the GBControl of the other group (gbcontrol_config.is_follow)
+  sc_out<NVUINT16> timestep_progress;
+  sc_in<NVUINT16>  follow_progress;
+  
+  // Per-PE completion: PEs done with the current timestep (their outputs already received)
+  sc_in<spec::PEMaskType> pe_done_status;
+
+  // Valid timesteps of each large buffer region (GBCore 0x4 local 0x05), written by GBRVA,
+  //   sampled at start
+  sc_in<spec::GB::Large::ValidLengthType> valid_length;
 
   // Constructor
   GBControl (sc_module_name nm)
@@ -91,7 +109,11 @@ class GBControl : public match::Module {
         data_out("data_out"),
         data_in("data_in"),
         pe_start("pe_start"),
-        pe_done("pe_done")
+        pe_done("pe_done"),
+        timestep_progress("timestep_progress"),
+        follow_progress("follow_progress"),
+        pe_done_status("pe_done_status"),
+        valid_length("valid_length")
   {
     SC_THREAD(GBControlRun);
     sensitive << clk.pos();
@@ -100,7 +122,7 @@ class GBControl : public match::Module {
 
   // A. FSM
   enum FSM {
-    IDLE, SEND, SEND2, START, RECV, SENDBACK, SENDBACK2, NEXT
+    IDLE, SEND, START, RECV, SENDBACK, NEXT
   };
   FSM state;                 
   
@@ -111,14 +133,39 @@ class GBControl : public match::Module {
   
   bool w_axi_rsp, w_done;
   spec::Axi::SlaveToRVA::Read rva_out_reg;    
+  
+  // Streaming read counters, vector index of next request/response
+  NVUINT8   issue_counter;
+  NVUINT8   return_counter;
+  spec::StreamType return_reg;   // response popped, not taken by data_out yet
+  bool      is_return_held;
+  
+  // x(t+1) prefetch during RECV (gbcontrol_config.is_prefetch)
+  bool      is_prefetch_run;
+  NVUINT8   prefetch_counter;   // number of x(t+1) vectors received by PE
+  bool      is_early_start;     // start of t+1 sent during RECV of t (gbcontrol_config.is_eager)
+  
+  NVUINT16  num_timestep_done;  // drives timestep_progress
     
   void Reset() {
     state = IDLE;
     is_start = 0;
     gbcontrol_config.Reset();
+    ResetStream();
+    is_prefetch_run   = 0;
+    prefetch_counter  = 0;
+    is_early_start    = 0;
+    num_timestep_done = 0;
+    timestep_progress.write(0);
     ResetPorts();
   }
   
+  void ResetStream() {
+    issue_counter   = 0;
+    return_counter  = 0;
+    is_return_held  = 0;
+  }
+  
   void ResetPorts() { 
     rva_in.Reset();
     rva_out.Reset();
@@ -134,11 +181,37 @@ class GBControl : public match::Module {
     pe_done.Reset();  
   }
 
+  // The timestep index here corresponds to hidden state (output) timestep index
+  //   for mode == 0: hidden state timestep index equals to input timestep index 
+  //   for mode == 1 or 2: hidden state timestep index needs right shift to match input timestep index
+  NVUINT16 GetInputTimestepIndex(const NVUINT16 counter) const {
+    NVUINT16 timestep_index = gbcontrol_config.GetTimestepIndexGBControl(counter);
+    if (gbcontrol_config.mode == 1 || gbcontrol_config.mode == 2) timestep_index = timestep_index >> 1;
+    return timestep_index;
+  }
+  
+  // Prefetch only in non-decoder mode and when there is a next timestep 
+  bool IsPrefetch() const {
+    return gbcontrol_config.is_prefetch && (gbcontrol_config.mode != 3) && 
+           (gbcontrol_config.timestep_counter < (gbcontrol_config.num_timestep_bound - 1));
+  }
+
+  // Per-PE completion: t+1 only needs x(t+1), which is prefetched to every PE
+  bool IsEager() const {
+    return is_prefetch_run && gbcontrol_config.is_eager && !gbcontrol_config.is_rnn;
+  }
+
+  // Layer pipelining: the input of timestep counter is written by the followed GBControl,
+  //   whose GB writes of a timestep are all issued before it counts the timestep
+  bool IsFollowReady(const NVUINT16 counter) const {
+    return !gbcontrol_config.is_follow || (follow_progress.read() > counter);
+  }
+
   void DecodeAxiWrite(const spec::Axi::SlaveToRVA::Write& rva_in_reg){
     NVUINT4     tmp = nvhls::get_slc<4>(rva_in_reg.addr, 20);
     NVUINT16    local_index = nvhls::get_slc<16>(rva_in_reg.addr, 4);
     
-    if (tmp == 0x7) {
+    if (tmp == 0x7 || tmp == 0xC) {   // 0xC: GBControl of PE group 1
       gbcontrol_config.ConfigWrite(local_index, rva_in_reg.data);
     }
   }   
@@ -150,7 +223,7 @@ class GBControl : public match::Module {
     
     // Set Push Response
     w_axi_rsp = 1;
-    if (tmp == 0x7) {
+    if (tmp == 0x7 || tmp == 0xC) {
       gbcontrol_config.ConfigRead(local_index, rva_out_reg.data);
     }    
   }
@@ -180,78 +253,104 @@ class GBControl : public match::Module {
     }  
   }
   
+  // Issue the next read request of the stream if there is room in flight
+  void StreamIssue(const NVUINT3 memory_index, const NVUINT16 timestep_index, const NVUINT8 num_vector) {
+    NVUINT8 num_outstanding = issue_counter - return_counter;
+    if ((issue_counter < num_vector) && (num_outstanding < kMaxOutstanding)) {
+      bool is_issued;
+      if (gbcontrol_config.mode != 3) { // Non- Decoder mode
+        spec::GB::Large::DataReq large_req_reg;
+        large_req_reg.is_write = 0;
+        large_req_reg.memory_index = memory_index;
+        large_req_reg.vector_index = issue_counter;
+        large_req_reg.timestep_index = timestep_index;
+        is_issued = large_req.PushNB(large_req_reg);
+      }
+      else {
+        spec::GB::Small::DataReq small_req_reg;          
+        small_req_reg.is_write = 0;
+        small_req_reg.memory_index = memory_index;
+        small_req_reg.vector_index = issue_counter;
+        is_issued = small_req.PushNB(small_req_reg);  
+      }
+      if (is_issued) {
+        issue_counter += 1;
+      }
+    }
+  }
+  
+  // Forward one read response to PE, responses return in request order, 
+  //   returns 1 if data_out took a response in this cycle
+  bool StreamReturn(const NVUINT1 stream_index) {
+    if (!is_return_held && (issue_counter != return_counter)) {
+      if (gbcontrol_config.mode != 3) { // Non- Decoder mode
+        spec::GB::Large::DataRsp<1> large_rsp_reg;
+        is_return_held = large_rsp.PopNB(large_rsp_reg);
+        return_reg.data = large_rsp_reg.read_vector[0];
+      }
+      else {
+        spec::GB::Small::DataRsp small_rsp_reg;
+        is_return_held = small_rsp.PopNB(small_rsp_reg);
+        return_reg.data = small_rsp_reg.read_data;
+      }
+    }
+    bool is_out = 0;
+    if (is_return_held) {
+      return_reg.index = stream_index;
+      return_reg.logical_addr = return_counter;
+      return_reg.pe_mask = gbcontrol_config.pe_mask;
+      if (data_out.PushNB(return_reg)) {
+        return_counter += 1;
+        is_return_held = 0;
+        is_out = 1;
+      }
+    }
+    return is_out;
+  }
+
   void RunFSM() {
     switch (state) {
       case IDLE: {
         break;
       }
       case SEND: {
-        // Send X From GB to PE
-        //spec::StreamType data_out_reg;
-        NVUINT3  memory_index = gbcontrol_config.memory_index_1;
-        NVUINT8  vector_index = gbcontrol_config.GetVectorIndex();
-        
-        NVUINT16 timestep_index = gbcontrol_config.GetTimestepIndexGBControl();
-
-        // The timestep index here corresponds to hidden state (output) timestep index
-        //   for mode == 0: hidden state timestep index equals to input timestep index 
-        //   for mode == 1 or 2: hidden state timestep index needs right shift to match input timestep index
-        if (gbcontrol_config.mode == 1 || gbcontrol_config.mode == 2) timestep_index = timestep_index >> 1;
-        
+        // Send X From GB to PE (Streaming index = 0 => data x)
         //XXX: use GB control version of GetTimestepIndex, the func is controlled by config.mode
-        if (gbcontrol_config.mode != 3) { // Non- Decoder mode
-          spec::GB::Large::DataReq large_req_reg;
-          large_req_reg.is_write = 0;
-          large_req_reg.memory_index = memory_index;
-          large_req_reg.vector_index = vector_index;
-          large_req_reg.timestep_index = timestep_index;
-          //cout << "large_req_reg.vector_index: " << large_req_reg.vector_index << "\t large_req_reg.timestep_index: " << large_req_reg.timestep_index << endl;
-          large_req.Push(large_req_reg);
-        }
-        else {
-          spec::GB::Small::DataReq small_req_reg;          
-          small_req_reg.is_write = 0;
-          small_req_reg.memory_index = memory_index;
-          small_req_reg.vector_index = vector_index;
-          
-          small_req.Push(small_req_reg);  
+        NVUINT16 timestep_index = GetInputTimestepIndex(gbcontrol_config.timestep_counter);
+        StreamReturn(x_index);
+        if (IsFollowReady(gbcontrol_config.timestep_counter)) {
+          StreamIssue(gbcontrol_config.memory_index_1, timestep_index, gbcontrol_config.num_vector_1);
         }
         break;
       }
-      case SEND2: {
-        spec::StreamType data_out_reg;
-        NVUINT8  vector_index = gbcontrol_config.GetVectorIndex();
-        if (gbcontrol_config.mode != 3) { // Non- Decoder mode
-          spec::GB::Large::DataRsp<1> large_rsp_reg;
-          large_rsp_reg = large_rsp.Pop();
-          
-          data_out_reg.data = large_rsp_reg.read_vector[0];
-          data_out_reg.index = x_index;
-          data_out_reg.logical_addr = vector_index;
-        }
-        else {
-          spec::GB::Small::DataRsp small_rsp_reg;
-          small_rsp_reg = small_rsp.Pop();
-          
-          data_out_reg.data = small_rsp_reg.read_data;
-          data_out_reg.index = x_index;
-          data_out_reg.logical_addr = vector_index;  
-        }
-        // Send The data to PE (Streaming index = 0 => data x)
-        data_out.Push(data_out_reg);
-        break;
-      }
       case START: {
-        // send PE start 
-        pe_start.Push(1);
+        // send PE start, unless already sent during RECV
+        if (!is_early_start) {
+          pe_start.Push(1);
+        }
+        is_early_start = 0;
         break;
       }
       case RECV: {
         // wait for Done while recieving data from PE and forward it to GB, memory_index_2;
+        //   x(t+1) is streamed to PE in between, a PE with PEConfig.is_input_dbuf takes it 
+        //   while running, otherwise it is held until the PE is done with t (StreamReturn),
+        //   a read is only issued in the cycles without GB write 
+        bool is_prefetch_out = 0;
+        if (is_prefetch_run) {
+          is_prefetch_out = StreamReturn(x_index);
+        }
+        
+        // data_out is taken by prefetch in this cycle, hold PE output for loopback
+        bool is_recv_ready = !(is_prefetch_out && gbcontrol_config.is_rnn && gbcontrol_config.is_loopback);
         spec::StreamType data_in_reg;        
-        if (data_in.PopNB(data_in_reg)) {
+        if (is_recv_ready && data_in.PopNB(data_in_reg)) {
           NVUINT3  memory_index = gbcontrol_config.memory_index_2;
           NVUINT16 timestep_index = gbcontrol_config.GetTimestepIndexGBControl();
+          // outputs of a PE already done with t are from t+1
+          if (is_early_start && ((data_in_reg.pe_src & pe_done_status.read()) != 0)) {
+            timestep_index = gbcontrol_config.GetTimestepIndexGBControl(gbcontrol_config.timestep_counter + 1);
+          }
           if (gbcontrol_config.mode != 3) { // Non-Decoder mode            
             spec::GB::Large::DataReq large_req_reg;
             large_req_reg.is_write = 1;
@@ -270,58 +369,38 @@ class GBControl : public match::Module {
             small_req_reg.write_data = data_in_reg.data;
             small_req.Push(small_req_reg);            
           }
+          
+          // RNN loopback: h(t) goes back to PE while it is written to GB, 
+          //   PE keeps it in the other input bank (PEConfig.is_input_dbuf)
+          if (gbcontrol_config.is_rnn && gbcontrol_config.is_loopback) {
+            spec::StreamType data_out_reg;
+            data_out_reg.data = data_in_reg.data;
+            data_out_reg.index = h_index;
+            data_out_reg.logical_addr = data_in_reg.logical_addr;
+            data_out_reg.pe_mask = gbcontrol_config.pe_mask;
+            data_out.Push(data_out_reg);
+          }
+        }
+        else if (is_prefetch_run && IsFollowReady(gbcontrol_config.timestep_counter + 1)) {
+          NVUINT16 timestep_index = GetInputTimestepIndex(gbcontrol_config.timestep_counter + 1);
+          StreamIssue(gbcontrol_config.memory_index_1, timestep_index, gbcontrol_config.num_vector_1);
+        }
+        
+        // x(t+1) fully prefetched: start t+1, PEStart applies it to each PE once done with t
+        if (IsEager() && !is_early_start && (return_counter == gbcontrol_config.num_vector_1)) {
+          pe_start.Push(1);
+          is_early_start = 1;
         }
         break;
       }
       case SENDBACK: { // data_out_reg.index = 1 for hidden state logical memory in PECore
         // If needed (e.g. RNN), broadcast activation (h) back to PE
         CDCOUT(sc_time_stamp() << name() << " CASE SENDBACK " << endl, kDebugLevel);
-        //spec::StreamType data_out_reg;
-        NVUINT3  memory_index = gbcontrol_config.memory_index_2;
-        NVUINT8  vector_index = gbcontrol_config.GetVectorIndex();
         NVUINT16 timestep_index = gbcontrol_config.GetTimestepIndexGBControl();
-        
-        if (gbcontrol_config.mode != 3) { // Non- Decoder mode
-          spec::GB::Large::DataReq large_req_reg;
-          large_req_reg.is_write = 0;
-          large_req_reg.memory_index = memory_index;
-          large_req_reg.vector_index = vector_index;
-          large_req_reg.timestep_index = timestep_index;
-          large_req.Push(large_req_reg);
-        }
-        else { 
-          spec::GB::Small::DataReq small_req_reg;          
-          small_req_reg.is_write = 0;
-          small_req_reg.memory_index = memory_index;
-          small_req_reg.vector_index = vector_index;
-          
-          small_req.Push(small_req_reg); 
-        }
+        StreamReturn(h_index);
+        StreamIssue(gbcontrol_config.memory_index_2, timestep_index, gbcontrol_config.num_vector_2);
         break;
       }
-      case SENDBACK2: {
-        spec::StreamType data_out_reg;
-        NVUINT8  vector_index = gbcontrol_config.GetVectorIndex();
-        if (gbcontrol_config.mode != 3) { // Non- Decoder mode
-          spec::GB::Large::DataRsp<1> large_rsp_reg;
-          large_rsp_reg = large_rsp.Pop();
-          
-          data_out_reg.data = large_rsp_reg.read_vector[0];
-          data_out_reg.index = h_index;
-          data_out_reg.logical_addr = vector_index;
-        }
-        else {
-          spec::GB::Small::DataRsp small_rsp_reg;
-          small_rsp_reg = small_rsp.Pop();
-          
-          data_out_reg.data = small_rsp_reg.read_data;
-          data_out_reg.index = h_index;
-          data_out_reg.logical_addr = vector_index;                   
-        }
-        // Send The data to PE (Streaming index = 0 => data x)
-        data_out.Push(data_out_reg);
-        break;        
-      }
       case NEXT: {
         CDCOUT(sc_time_stamp() << name() << " CASE NEXT " << endl, kDebugLevel);
         break;
@@ -345,6 +424,18 @@ class GBControl : public match::Module {
         // Wait for start signal (Axi config)
         if (is_start) {
           gbcontrol_config.ResetCounter();
+          gbcontrol_config.ValidLengthWrite(valid_length.read());
+          // bidirectional modes interleave both directions in the region, 
+          //   the valid length only bounds unidirectional runs (reads past it are still zero)
+          if (gbcontrol_config.mode == 0) {
+            gbcontrol_config.SetTimestepBound(gbcontrol_config.memory_index_1);
+          }
+          else {
+            gbcontrol_config.num_timestep_bound = gbcontrol_config.num_timestep_1;
+          }
+          ResetStream();
+          num_timestep_done = 0;
+          timestep_progress.write(0);
           next_state = SEND;
         }
         else {
@@ -353,14 +444,9 @@ class GBControl : public match::Module {
         break;
       }
       case SEND: {
-        next_state = SEND2;
-        break;
-      }
-      case SEND2: {
         // Send Data from GB to PE
-        bool is_end = 0;
-        gbcontrol_config.UpdateVectorCounter(0, is_end);
-        if (is_end) {
+        if (return_counter == gbcontrol_config.num_vector_1) {
+          ResetStream();
           next_state = START;
         }
         else {
@@ -371,14 +457,19 @@ class GBControl : public match::Module {
       case START: {
         // send PE start 
         //cout << "GB send PE Start" << endl;
+        is_prefetch_run = IsPrefetch();
         next_state = RECV;
         break;
       }
       case RECV: {
         // wait for Done while recieving data from PE and forward it to GB
         bool pe_done_reg;
-        if (pe_done.PopNB(pe_done_reg)) {
-          if (gbcontrol_config.is_rnn) {
+        // the prefetch reads in flight must be consumed before leaving RECV
+        if ((issue_counter == return_counter) && pe_done.PopNB(pe_done_reg)) {
+          prefetch_counter = return_counter;
+          ResetStream();
+          // h(t) already forwarded in RECV for loopback
+          if (gbcontrol_config.is_rnn && !gbcontrol_config.is_loopback) {
             next_state = SENDBACK;
           }
           else {
@@ -391,14 +482,9 @@ class GBControl : public match::Module {
         break;
       }
       case SENDBACK: {
-        next_state = SENDBACK2;
-        break;
-      }
-      case SENDBACK2: {
         // If needed (e.g. RNN), broadcast activation back to PE
-        bool is_end = 0;
-        gbcontrol_config.UpdateVectorCounter(1, is_end);
-        if (is_end) {
+        if (return_counter == gbcontrol_config.num_vector_2) {
+          ResetStream();
           next_state = NEXT;
         }
         else {
@@ -409,6 +495,8 @@ class GBControl : public match::Module {
       case NEXT: {
         // Move to next timestep
         bool is_end = 0;
+        num_timestep_done += 1;
+        timestep_progress.write(num_timestep_done);
         gbcontrol_config.UpdateTimestepCounter(is_end);
         if (is_end) {
           // Pushdone 
@@ -417,9 +505,19 @@ class GBControl : public match::Module {
           CDCOUT(sc_time_stamp()  << " GBControl: " << name() << " Finish" << endl, kDebugLevel);
           done.Push(1);    
         }
+        else if (is_prefetch_run && (prefetch_counter == gbcontrol_config.num_vector_1)) {
+          // x(t+1) fully prefetched
+          next_state = START;
+        }
         else {
+          // send the remaining x vectors 
+          if (is_prefetch_run) {
+            issue_counter = prefetch_counter;
+            return_counter = prefetch_counter;
+          }
           next_state = SEND;
         }
+        is_prefetch_run = 0;
         break;
       }
       default: {
@@ -240,6 +240,9 @@ SC_MODULE(testbench) {
   
   Connections::Combinational<bool> pe_start;
   Connections::Combinational<bool> pe_done;
+  sc_signal<NVUINT16> timestep_progress;
+  sc_signal<spec::PEMaskType> pe_done_status;
+  sc_signal<spec::GB::Large::ValidLengthType> valid_length;   // 0: whole region
 
   NVHLS_DESIGN(GBControl) dut;
   Source  source;
@@ -267,6 +270,10 @@ SC_MODULE(testbench) {
     dut.data_in(data_in);
     dut.pe_start(pe_start);
     dut.pe_done(pe_done);
+    dut.timestep_progress(timestep_progress);
+    dut.follow_progress(timestep_progress);
+    dut.pe_done_status(pe_done_status);
+    dut.valid_length(valid_length);
     
     source.clk(clk);
     source.rst(rst);
@@ -43,6 +43,9 @@ class GBCore : public match::Module {
   // AXI Config For Large Buffer
   NVUINT8   num_vector_large[spec::GB::Large::kMaxNumManagers]; 
   NVUINT16  base_large[spec::GB::Large::kMaxNumManagers];    // this should be 4
+  // Valid timesteps per region (local 0x05), 0: whole region 
+  //   reads past it return zero without accessing the SRAM
+  NVUINT16  valid_length_large[spec::GB::Large::kMaxNumManagers];
   
   // AXI Config For Small Buffer  
   NVUINT16  base_small[spec::GB::Small::kMaxNumManagers];    // this should be 8  
@@ -59,6 +62,33 @@ class GBCore : public match::Module {
   bool                        large_port_read_out_valid  [spec::GB::Large::kNumReadPorts];
   
 
+ 
+  // Streaming requests of the large buffer are held until granted, one slot per requester
+  //   0: GBControl, 1: LayerReduce, 2: LayerNorm, 3: ZeroPadding, 4: Attention, 5: GBControl (PE group 1)
+  static const int kNumLargeRequesters = 6;
+  spec::GB::Large::DataReq    large_req_regs              [kNumLargeRequesters];
+  bool                        large_req_valid             [kNumLargeRequesters];
+  GBArbiter<kNumLargeRequesters> large_arb;               // AXI 0x4 local 0x03
+  
+  // Read responses are held per requester until taken (PushNB), a stalled requester 
+  //   only holds back its own reads, its writes and the other requesters go on
+  bool                          large_rsp_valid           [kNumLargeRequesters];
+  spec::GB::Large::DataRsp<1>   gbcontrol_large_rsp_reg;
+  spec::GB::Large::DataRsp<8>   layerreduce_large_rsp_reg;
+  spec::GB::Large::DataRsp<1>   layernorm_large_rsp_reg;
+  spec::GB::Large::DataRsp<1>   zeropadding_large_rsp_reg;
+  spec::GB::Large::DataRsp<16>  attention_large_rsp_reg;
+  spec::GB::Large::DataRsp<1>   gbcontrol_1_large_rsp_reg;
+
+  // Streaming requests of the small buffer, 0: GBControl, 1: LayerNorm, 2: Attention, 3: GBControl (PE group 1)
+  static const int kNumSmallRequesters = 4;
+  spec::GB::Small::DataReq    small_req_regs              [kNumSmallRequesters];
+  bool                        small_req_valid             [kNumSmallRequesters];
+  GBArbiter<kNumSmallRequesters> small_arb;               // AXI 0x4 local 0x04
+  bool                        small_half                  [kNumSmallRequesters];  // dual read with bank conflict, first read done
+  spec::GB::Small::DataRsp    small_rsp_regs              [kNumSmallRequesters];
+  bool                        small_rsp_valid             [kNumSmallRequesters];  // small_rsp_regs not taken yet
+
   spec::GB::Small::Address    small_read_addrs            [spec::GB::Small::kNumReadPorts]; 
   bool                        small_read_req_valid        [spec::GB::Small::kNumReadPorts];     
   spec::GB::Small::Address    small_write_addrs           [spec::GB::Small::kNumWritePorts];
@@ -79,13 +109,15 @@ class GBCore : public match::Module {
   Connections::In<spec::GB::Large::DataReq>       gbcontrol_large_req;
   Connections::Out<spec::GB::Large::DataRsp<1>>   gbcontrol_large_rsp;   
   Connections::In<spec::GB::Large::DataReq>       layerreduce_large_req;
-  Connections::Out<spec::GB::Large::DataRsp<2>>   layerreduce_large_rsp;       
+  Connections::Out<spec::GB::Large::DataRsp<8>>   layerreduce_large_rsp;       
   Connections::In<spec::GB::Large::DataReq>       layernorm_large_req;
   Connections::Out<spec::GB::Large::DataRsp<1>>   layernorm_large_rsp;  
   Connections::In<spec::GB::Large::DataReq>       zeropadding_large_req;
   Connections::Out<spec::GB::Large::DataRsp<1>>   zeropadding_large_rsp;  
   Connections::In<spec::GB::Large::DataReq>       attention_large_req;
   Connections::Out<spec::GB::Large::DataRsp<16>>  attention_large_rsp;   
+  Connections::In<spec::GB::Large::DataReq>       gbcontrol_1_large_req;
+  Connections::Out<spec::GB::Large::DataRsp<1>>   gbcontrol_1_large_rsp;   
   
   Connections::In<spec::Axi::SlaveToRVA::Write>   rva_in_small; 
   Connections::Out<spec::Axi::SlaveToRVA::Read>   rva_out_small;  
@@ -96,10 +128,13 @@ class GBCore : public match::Module {
 
   Connections::In<spec::GB::Small::DataReq>       attention_small_req;
   Connections::Out<spec::GB::Small::DataRsp>      attention_small_rsp;   
+  Connections::In<spec::GB::Small::DataReq>       gbcontrol_1_small_req;
+  Connections::Out<spec::GB::Small::DataRsp>      gbcontrol_1_small_rsp;   
 
     
   // Access only by the larger buffer thread
   sc_in<NVUINT32> SC_SRAM_CONFIG;
+  sc_in<spec::PEMaskType> SC_PE_GROUP;    // written by GBRVA (0x4 local 0x06), read back here
   
   
   // Constructor
@@ -119,6 +154,8 @@ class GBCore : public match::Module {
         zeropadding_large_rsp ("zeropadding_large_rsp"),
         attention_large_req   ("attention_large_req"),
         attention_large_rsp   ("attention_large_rsp"),
+        gbcontrol_1_large_req ("gbcontrol_1_large_req"),
+        gbcontrol_1_large_rsp ("gbcontrol_1_large_rsp"),
 
 
         rva_in_small          ("rva_in_small"),
@@ -129,8 +166,11 @@ class GBCore : public match::Module {
         layernorm_small_rsp   ("layernorm_small_rsp"),  
         attention_small_req   ("attention_small_req"),
         attention_small_rsp   ("attention_small_rsp"), 
+        gbcontrol_1_small_req ("gbcontrol_1_small_req"),
+        gbcontrol_1_small_rsp ("gbcontrol_1_small_rsp"), 
                                
-        SC_SRAM_CONFIG        ("SC_SRAM_CONFIG")
+        SC_SRAM_CONFIG        ("SC_SRAM_CONFIG"),
+        SC_PE_GROUP           ("SC_PE_GROUP")
   {
     SC_THREAD(LargeRun);
     sensitive << clk.pos();
@@ -158,13 +198,10 @@ class GBCore : public match::Module {
 
   // ArbitratedCrossbar<spec::GB::Large::DataReq, 5, 1, 0, 0> arbxbar_large;
 
-  // this N should matche the number of read 
-  template<unsigned N>
-  inline void SetLargeBuffer(const spec::GB::Large::DataReq large_req_reg) {
+  inline spec::GB::Large::Address GetLargeAddr(const spec::GB::Large::DataReq& large_req_reg) const {
     NVUINT3                     memory_index = large_req_reg.memory_index;
     NVUINT8                     vector_index = large_req_reg.vector_index;
     NVUINT16                    timestep_index = large_req_reg.timestep_index;    
-    spec::GB::Large::WordType   write_data = large_req_reg.write_data;
   
     NVUINT4   lower_timestep_index = nvhls::get_slc<4>(timestep_index, 0);
     NVUINT12  upper_timestep_index = nvhls::get_slc<12>(timestep_index, 4);  
@@ -172,39 +209,221 @@ class GBCore : public match::Module {
     spec::GB::Large::Address base_addr = 
                                 base_large[memory_index] + lower_timestep_index + 
                                 (upper_timestep_index*num_vector_large[memory_index] + vector_index)*16;
+    return base_addr;
+  }
+  
+  // Lower address bits select the bank 
+  inline spec::GB::Large::BankIndex GetLargeBank(const spec::GB::Large::Address addr) const {
+    return nvhls::get_slc<spec::GB::Large::kBankIndexSize>(addr, 0);
+  }
+  
+  // Lane i of an N-wide read is timestep_index + i, lanes past the valid length are zero
+  template<unsigned N>
+  inline NVUINT16 GetLargeZeroMask(const spec::GB::Large::DataReq& large_req_reg) const {
+    NVUINT16 zero_mask = 0;
+    NVUINT16 length = valid_length_large[nvhls::get_slc<2>(large_req_reg.memory_index, 0)];
+    #pragma hls_unroll yes 
+    for (unsigned i = 0; i < N; i++) {
+      NVUINTW(17) lane_timestep = large_req_reg.timestep_index + i;
+      if ((length != 0) && (lane_timestep >= length)) {
+        zero_mask[i] = 1;
+      }
+    }
+    return zero_mask;
+  }
+  
+  // Read port p always serves bank p, so N consecutive reads starting at 
+  //   base_addr use ports (base_bank + i) % kNumBanks and never collide
+  template<unsigned N>
+  inline NVUINT16 GetLargeBankMask(const spec::GB::Large::Address base_addr, const NVUINT16 zero_mask) const {
+    NVUINT16 bank_mask = 0;
+    spec::GB::Large::BankIndex base_bank = GetLargeBank(base_addr);
+    #pragma hls_unroll yes 
+    for (unsigned i = 0; i < spec::GB::Large::kNumBanks; i++) {
+      spec::GB::Large::BankIndex offset = i - base_bank;
+      if ((offset < N) && (zero_mask[offset] == 0)) {
+        bank_mask[i] = 1;
+      }
+    }
+    return bank_mask;
+  }
+  
+  template<unsigned N>
+  inline void SetLargeRead(const spec::GB::Large::Address base_addr, const NVUINT16 zero_mask) {
+    spec::GB::Large::BankIndex base_bank = GetLargeBank(base_addr);
+    #pragma hls_unroll yes 
+    for (unsigned i = 0; i < spec::GB::Large::kNumReadPorts; i++) { 
+      spec::GB::Large::BankIndex offset = i - base_bank;
+      if ((offset < N) && (zero_mask[offset] == 0)) {
+        large_read_addrs          [i] = base_addr + offset;
+        large_read_req_valid      [i] = 1;   
+        large_read_ready          [i] = 1;
+      }
+    }
+  }
+  
+  template<unsigned N>
+  inline void GetLargeRead(const spec::GB::Large::BankIndex base_bank, const NVUINT16 zero_mask, 
+                           spec::GB::Large::DataRsp<N>& large_rsp_reg) const {
+    #pragma hls_unroll yes
+    for (unsigned i = 0; i < N; i++) {
+      spec::GB::Large::BankIndex port = base_bank + i;
+      if (zero_mask[i] == 1) {
+        large_rsp_reg.read_vector[i] = 0;
+      }
+      else {
+        large_rsp_reg.read_vector[i] = large_port_read_out[port];
+      }
+    }
+  }
+  
+  // Grant a held request if its banks (and the write port) are still free in this cycle
+  //   single port SRAM: a read and a write can not share a bank, 
+  //   read lanes from num_lane on are neither read nor reserved
+  template<unsigned N>
+  inline bool GrantLarge(const spec::GB::Large::DataReq& large_req_reg, 
+                         NVUINT16& bank_mask, bool& is_write_busy, 
+                         spec::GB::Large::BankIndex& base_bank, NVUINT16& zero_mask,
+                         const NVUINT5 num_lane = N) {
+    bool is_grant = 0;
+    spec::GB::Large::Address base_addr = GetLargeAddr(large_req_reg);
+    base_bank = GetLargeBank(base_addr);
     if (large_req_reg.is_write) {
-      large_write_addrs         [0] = base_addr;
-      //cout << "write_address in GBCore: " << base_addr << endl;
-      large_write_req_valid     [0] = 1;
-      large_write_data          [0] = write_data;
+      NVUINT16 req_mask = 0;
+      req_mask[base_bank] = 1;
+      if (!is_write_busy && ((bank_mask & req_mask) == 0)) {
+        large_write_addrs         [0] = base_addr;
+        large_write_req_valid     [0] = 1;
+        large_write_data          [0] = large_req_reg.write_data;
+        bank_mask |= req_mask;
+        is_write_busy = 1;
+        is_grant = 1;
+      }
     }
     else {
+      zero_mask = GetLargeZeroMask<N>(large_req_reg);
       #pragma hls_unroll yes 
-      for (unsigned i = 0; i < N; i++) { 
-        large_read_addrs          [i] = base_addr + i;
-        large_read_req_valid      [i] = 1;   
-        large_read_ready          [i] = 1;
+      for (unsigned i = 0; i < N; i++) {
+        if (i >= num_lane) {
+          zero_mask[i] = 1;
+        }
+      }
+      NVUINT16 req_mask = GetLargeBankMask<N>(base_addr, zero_mask);
+      if ((bank_mask & req_mask) == 0) {
+        SetLargeRead<N>(base_addr, zero_mask);
+        bank_mask |= req_mask;
+        is_grant = 1;
       }
     }
+    return is_grant;
   }
  
   
-  inline void SetSmallBuffer(const spec::GB::Small::DataReq small_req_reg) {
-    NVUINT3                     memory_index = small_req_reg.memory_index;
-    NVUINT8                     vector_index = small_req_reg.vector_index;
-    spec::GB::Small::WordType   write_data = small_req_reg.write_data;
-    
+  inline bool GrantLargeReq(const unsigned i, NVUINT16& bank_mask, bool& is_write_busy, 
+                            spec::GB::Large::BankIndex& base_bank, NVUINT16& zero_mask) {
+    bool is_grant = 0;
+    switch (i) {
+      case 1: { // LayerReduce, num_pool (up to 8) timesteps
+        NVUINT5 num_lane = 1;
+        num_lane = num_lane << large_req_regs[i].pool_shift;
+        is_grant = GrantLarge<8>(large_req_regs[i], bank_mask, is_write_busy, base_bank, zero_mask, num_lane);
+        break;
+      }
+      case 4:   // Attention
+        is_grant = GrantLarge<16>(large_req_regs[i], bank_mask, is_write_busy, base_bank, zero_mask);
+        break;
+      default:  // GBControl (both groups), LayerNorm, ZeroPadding
+        is_grant = GrantLarge<1>(large_req_regs[i], bank_mask, is_write_busy, base_bank, zero_mask);
+        break;
+    }
+    return is_grant;
+  }
+  
+  // Upper address bits select the bank so that each bank holds a contiguous quarter,
+  //   memory regions (base_small) placed in different quarters never conflict.
+  //   The SRAM model takes the bank from the lower address bits. 
+  inline spec::GB::Small::Address SmallSwizzle(const spec::GB::Small::Address logical_addr) const {
+    spec::GB::Small::Address addr = 0;
+    addr.set_slc<spec::GB::Small::kBankIndexSize>(0, 
+          nvhls::get_slc<spec::GB::Small::kBankIndexSize>(logical_addr, spec::GB::Small::kLocalIndexSize));
+    addr.set_slc<spec::GB::Small::kLocalIndexSize>(spec::GB::Small::kBankIndexSize, 
+          nvhls::get_slc<spec::GB::Small::kLocalIndexSize>(logical_addr, 0));
+    return addr;
+  }
+  
+  inline spec::GB::Small::Address GetSmallAddr(const NVUINT3 memory_index, const NVUINT8 vector_index) const {
     spec::GB::Small::Address base_addr = vector_index + base_small[memory_index];
+    return SmallSwizzle(base_addr);
+  }
+  
+  inline spec::GB::Small::BankIndex GetSmallBank(const spec::GB::Small::Address addr) const {
+    return nvhls::get_slc<spec::GB::Small::kBankIndexSize>(addr, 0);
+  }
+  
+  inline void SetSmallRead(const NVUINT1 port, const spec::GB::Small::Address addr) {
+    small_read_addrs          [port] = addr; 
+    small_read_req_valid      [port] = 1;  
+    small_read_ready          [port] = 1;  
+  }
+  
+  // Grant the held request i if its banks and ports are free in this cycle, 
+  //   a dual read hitting one bank takes two cycles (first read kept in small_rsp_regs)
+  //   returns 1 when the request is complete
+  inline bool GrantSmall(const unsigned i, NVUINT4& bank_mask, NVUINT2& num_read, bool& is_write_busy,
+                         bool& get_1, bool& get_2, NVUINT1& port_1, NVUINT1& port_2) {
+    spec::GB::Small::DataReq small_req_reg = small_req_regs[i];
+    spec::GB::Small::Address addr_1 = GetSmallAddr(small_req_reg.memory_index, small_req_reg.vector_index);
+    spec::GB::Small::Address addr_2 = GetSmallAddr(small_req_reg.memory_index_2, small_req_reg.vector_index_2);
+    spec::GB::Small::BankIndex bank_1 = GetSmallBank(addr_1);
+    spec::GB::Small::BankIndex bank_2 = GetSmallBank(addr_2);
+    bool is_done = 0;
+    
     if (small_req_reg.is_write) {
-      small_write_addrs         [0] = base_addr;
-      small_write_req_valid     [0] = 1;
-      small_write_data          [0] = write_data;    
+      if (!is_write_busy && (bank_mask[bank_1] == 0)) {
+        small_write_addrs         [0] = addr_1;
+        small_write_req_valid     [0] = 1;
+        small_write_data          [0] = small_req_reg.write_data;    
+        bank_mask[bank_1] = 1;
+        is_write_busy = 1;
+        is_done = 1;
+      }
     }
     else {
-      small_read_addrs          [0] = base_addr; 
-      small_read_req_valid      [0] = 1;  
-      small_read_ready          [0] = 1;  
-    }    
+      bool need_1 = !small_half[i];
+      bool need_2 = small_req_reg.is_dual;
+      if (need_1 && (num_read < spec::GB::Small::kNumReadPorts) && (bank_mask[bank_1] == 0)) {
+        port_1 = num_read;
+        SetSmallRead(port_1, addr_1);
+        bank_mask[bank_1] = 1;
+        num_read += 1;
+        get_1 = 1;
+      }
+      if (need_2 && (get_1 || !need_1) && (num_read < spec::GB::Small::kNumReadPorts) && (bank_mask[bank_2] == 0)) {
+        port_2 = num_read;
+        SetSmallRead(port_2, addr_2);
+        bank_mask[bank_2] = 1;
+        num_read += 1;
+        get_2 = 1;
+      }
+      is_done = (get_1 || !need_1) && (get_2 || !need_2);
+    }
+    return is_done;
+  }
+  
+  // A requester with a held read response is not granted another read
+  inline bool IsLargeReqReady(const unsigned i) const {
+    return large_req_valid[i] && (large_req_regs[i].is_write || !large_rsp_valid[i]);
+  }
+  
+  inline bool IsSmallReqReady(const unsigned i) const {
+    return small_req_valid[i] && (small_req_regs[i].is_write || !small_rsp_valid[i]);
+  }
+  
+  template<class RspType>
+  inline void PushRsp(Connections::Out<RspType>& rsp_port, const RspType& rsp_reg, bool& rsp_valid) {
+    if (rsp_valid && rsp_port.PushNB(rsp_reg)) {
+      rsp_valid = 0;
+    }
   }
   
   void LargeRun() {
@@ -220,20 +439,32 @@ class GBCore : public match::Module {
     zeropadding_large_rsp.Reset();        
     attention_large_req.Reset();
     attention_large_rsp.Reset();
+    gbcontrol_1_large_req.Reset();
+    gbcontrol_1_large_rsp.Reset();
     
     #pragma hls_unroll yes    
     for (int i = 0; i < spec::GB::Large::kMaxNumManagers; i++) {
       num_vector_large[i] = 1; 
       base_large[i]        = 0;
+      valid_length_large[i] = 0;
+    }
+    #pragma hls_unroll yes    
+    for (int i = 0; i < kNumLargeRequesters; i++) {
+      large_req_valid[i] = 0;
+      large_rsp_valid[i] = 0;
     }
+    large_arb.Reset();
 
     #pragma hls_pipeline_init_interval 1
     while(1) {
-      bool is_axi = 0;
-      //bool is_axi_rsp = 0;
       NVUINT4 rsp_mode = 0; 
       spec::Axi::SlaveToRVA::Write rva_in_reg;
       spec::Axi::SlaveToRVA::Read rva_out_reg;          
+      
+      // banks and write port taken in this cycle
+      NVUINT16 bank_mask = 0;
+      bool is_write_busy = 0;
+      spec::GB::Large::BankIndex axi_bank = 0;
 
       #pragma hls_unroll yes 
       for (unsigned i = 0; i < spec::GB::Large::kNumReadPorts; i++) { 
@@ -245,11 +476,11 @@ class GBCore : public match::Module {
       large_write_req_valid     [0] = 0;
       large_write_data          [0] = 0;
        
-
+      // AXI has the highest priority but only takes the bank it accesses
       if (rva_in_large.PopNB(rva_in_reg)) {
-        is_axi = 1;
         NVUINT4     tmp = nvhls::get_slc<4>(rva_in_reg.addr, 20);
         NVUINT16    local_index = nvhls::get_slc<16>(rva_in_reg.addr, 4);
+        axi_bank = GetLargeBank(local_index);
         if(rva_in_reg.rw) {
           CDCOUT(sc_time_stamp()  << " GBCore Large: " << name() << "RVA Write " << endl, kDebugLevel);    
 
@@ -262,12 +493,23 @@ class GBCore : public match::Module {
                   base_large[i]       = nvhls::get_slc<16>(rva_in_reg.data, 32*i+16);
                 }
               }
+              else if (local_index == 0x03) {
+                large_arb.ConfigWrite(rva_in_reg.data);
+              }
+              else if (local_index == 0x05) {
+                #pragma hls_unroll yes    
+                for (int i = 0; i < spec::GB::Large::kMaxNumManagers; i++) {
+                  valid_length_large[i] = nvhls::get_slc<16>(rva_in_reg.data, 16*i);
+                }
+              }
               break;
             }
             case 0x5: {    
               large_write_addrs         [0] = local_index;
               large_write_req_valid     [0] = 1;
               large_write_data          [0] = rva_in_reg.data; 
+              bank_mask[axi_bank] = 1;
+              is_write_busy = 1;
               break;
             }
             default: {
@@ -277,7 +519,6 @@ class GBCore : public match::Module {
         }
         else {
           CDCOUT(sc_time_stamp()  << " GBCore Large: " << name() << "RVA Read " << endl, kDebugLevel);
-          //is_axi_rsp = 1;
           rva_out_reg.data = 0; 
           switch (tmp) {
           case 0x3: {
@@ -293,13 +534,26 @@ class GBCore : public match::Module {
                 rva_out_reg.data.set_slc<16>(32*i+16, base_large[i]);
               }
             }
+            else if (local_index == 0x03) {
+              large_arb.ConfigRead(rva_out_reg.data);
+            }
+            else if (local_index == 0x05) {
+              #pragma hls_unroll yes    
+              for (int i = 0; i < spec::GB::Large::kMaxNumManagers; i++) {
+                rva_out_reg.data.set_slc<16>(16*i, valid_length_large[i]);
+              }
+            }
+            else if (local_index == 0x06) {
+              rva_out_reg.data.set_slc<spec::kNumPE>(0, SC_PE_GROUP.read());
+            }
             rsp_mode = 0x4;  
             break;          
           }
           case 0x5: {    
-            large_read_addrs          [0] = local_index;
-            large_read_req_valid      [0] = 1;   
-            large_read_ready          [0] = 1;
+            large_read_addrs          [axi_bank] = local_index;
+            large_read_req_valid      [axi_bank] = 1;   
+            large_read_ready          [axi_bank] = 1;
+            bank_mask[axi_bank] = 1;
             rsp_mode = 0x5;
             break;
           }
@@ -310,60 +564,39 @@ class GBCore : public match::Module {
         }
       }      
 
-// Change this part to Arxbar, If no axi, check streaming request  
-// TODO The req should be changed to array form 
-      // 1. PopNB list
-      NVUINT5 valid_regs = 0; 
-      NVUINT3 pos = 0;
-      spec::GB::Large::DataReq large_req_regs[5];   
-      if (is_axi == 0) {     
-        valid_regs[0] = gbcontrol_large_req.  PopNB(large_req_regs[0]);
-        valid_regs[1] = layerreduce_large_req.PopNB(large_req_regs[1]);
-        valid_regs[2] = layernorm_large_req.  PopNB(large_req_regs[2]);
-        valid_regs[3] = zeropadding_large_req.PopNB(large_req_regs[3]);
-        valid_regs[4] = attention_large_req.  PopNB(large_req_regs[4]);
-               
-      // 2. leading one detect
-        pos = nvhls::leading_ones<5, NVUINT5, NVUINT3>(valid_regs); 
+      // 1. PopNB into the empty request slots
+      if (!large_req_valid[0]) large_req_valid[0] = gbcontrol_large_req.  PopNB(large_req_regs[0]);
+      if (!large_req_valid[1]) large_req_valid[1] = layerreduce_large_req.PopNB(large_req_regs[1]);
+      if (!large_req_valid[2]) large_req_valid[2] = layernorm_large_req.  PopNB(large_req_regs[2]);
+      if (!large_req_valid[3]) large_req_valid[3] = zeropadding_large_req.PopNB(large_req_regs[3]);
+      if (!large_req_valid[4]) large_req_valid[4] = attention_large_req.  PopNB(large_req_regs[4]);
+      if (!large_req_valid[5]) large_req_valid[5] = gbcontrol_1_large_req.PopNB(large_req_regs[5]);
+      
+      // 2. grant every request without bank conflict, 
+      //   high priority requesters (large_arb) first then the others
+      bool                        large_ready     [kNumLargeRequesters];
+      bool                        large_grant     [kNumLargeRequesters];
+      spec::GB::Large::BankIndex  large_base_bank [kNumLargeRequesters];
+      NVUINT16                    large_zero_mask [kNumLargeRequesters];
+      bool                        large_high      [kNumLargeRequesters];
+      large_arb.GetPriority(large_high);
+      #pragma hls_unroll yes    
+      for (int i = 0; i < kNumLargeRequesters; i++) {
+        large_ready[i] = IsLargeReqReady(i);
+        large_grant[i] = 0;
+        large_base_bank[i] = 0;
+        large_zero_mask[i] = 0;
       }
-     
-      if (valid_regs != 0) {
-        spec::GB::Large::DataReq large_req_reg = large_req_regs[pos];
-        switch(pos){ 
-          case 0:
-            SetLargeBuffer<1>(large_req_reg);
-            if (!large_req_reg.is_write) {
-              rsp_mode = 0x7;      
-            }          
-            break;
-          case 1:
-            SetLargeBuffer<2>(large_req_reg);
-            if (!large_req_reg.is_write) {
-              rsp_mode = 0x8;      
-            }                  
-            break;
-          case 2:
-            SetLargeBuffer<1>(large_req_reg);
-            if (!large_req_reg.is_write) {
-              rsp_mode = 0x9;      
-            }           
-            break;
-          case 3:
-            SetLargeBuffer<1>(large_req_reg);
-            if (!large_req_reg.is_write) {
-              rsp_mode = 0xA;      
-            }            
-            break;      
-          case 4:
-            SetLargeBuffer<16>(large_req_reg);   
-            if (!large_req_reg.is_write) {
-              rsp_mode = 0xB;
-            }          
-            break;
-          default:        
-            break;          
+      #pragma hls_unroll yes    
+      for (int pass = 0; pass < 2; pass++) {
+        #pragma hls_unroll yes    
+        for (int i = 0; i < kNumLargeRequesters; i++) {
+          if (large_ready[i] && (large_high[i] == (pass == 0))) {
+            large_grant[i] = GrantLargeReq(i, bank_mask, is_write_busy, large_base_bank[i], large_zero_mask[i]);
+          }
         }
       }
+      large_arb.Update(large_ready, large_grant, large_high);
     
       large_mem.run(
         large_read_addrs          , 
@@ -386,48 +619,53 @@ class GBCore : public match::Module {
           break;
         }
         case 0x5: {
-          rva_out_reg.data = large_port_read_out[0].to_rawbits();
+          rva_out_reg.data = large_port_read_out[axi_bank].to_rawbits();
           rva_out_large.Push(rva_out_reg);
           break;        
         }
-        case 0x7: { // GBControl
-          spec::GB::Large::DataRsp<1>  large_rsp_reg;
-          large_rsp_reg.read_vector[0] = large_port_read_out[0];
-          gbcontrol_large_rsp.Push(large_rsp_reg);
-          break;
-        }
-        case 0x8: { // LayerReduce
-          spec::GB::Large::DataRsp<2>  large_rsp_reg;
-          large_rsp_reg.read_vector[0] = large_port_read_out[0];
-          large_rsp_reg.read_vector[1] = large_port_read_out[1];
-          layerreduce_large_rsp.Push(large_rsp_reg);
-          break;
-        }
-        case 0x9: { // LayerNorm
-          spec::GB::Large::DataRsp<1>  large_rsp_reg;
-          large_rsp_reg.read_vector[0] = large_port_read_out[0];
-          layernorm_large_rsp.Push(large_rsp_reg);  
-          break;
-        }
-        case 0xA: { // ZeroPadding
-          spec::GB::Large::DataRsp<1>  large_rsp_reg;        
-          large_rsp_reg.read_vector[0] = large_port_read_out[0];
-          zeropadding_large_rsp.Push(large_rsp_reg);
-          break;
-        }
-        case 0xB: {// TODO attention start 
-          spec::GB::Large::DataRsp<16>  large_rsp_reg;                            
-          #pragma hls_unroll yes
-          for (int i = 0; i < 16; i++) {
-            large_rsp_reg.read_vector[i] = large_port_read_out[i];
-          }
-          attention_large_rsp.Push(large_rsp_reg);
-          break; 
-        }
         default: {
           break;  
         }
       }    
+      
+      // 3. read responses of the granted requests, held until taken
+      if (large_grant[0] && !large_req_regs[0].is_write) { // GBControl
+        GetLargeRead<1>(large_base_bank[0], large_zero_mask[0], gbcontrol_large_rsp_reg);
+        large_rsp_valid[0] = 1;
+      }
+      if (large_grant[1] && !large_req_regs[1].is_write) { // LayerReduce
+        GetLargeRead<8>(large_base_bank[1], large_zero_mask[1], layerreduce_large_rsp_reg);
+        large_rsp_valid[1] = 1;
+      }
+      if (large_grant[2] && !large_req_regs[2].is_write) { // LayerNorm
+        GetLargeRead<1>(large_base_bank[2], large_zero_mask[2], layernorm_large_rsp_reg);
+        large_rsp_valid[2] = 1;
+      }
+      if (large_grant[3] && !large_req_regs[3].is_write) { // ZeroPadding
+        GetLargeRead<1>(large_base_bank[3], large_zero_mask[3], zeropadding_large_rsp_reg);
+        large_rsp_valid[3] = 1;
+      }
+      if (large_grant[4] && !large_req_regs[4].is_write) { // Attention
+        GetLargeRead<16>(large_base_bank[4], large_zero_mask[4], attention_large_rsp_reg);
+        large_rsp_valid[4] = 1;
+      }
+      if (large_grant[5] && !large_req_regs[5].is_write) { // GBControl (PE group 1)
+        GetLargeRead<1>(large_base_bank[5], large_zero_mask[5], gbcontrol_1_large_rsp_reg);
+        large_rsp_valid[5] = 1;
+      }
+      PushRsp(gbcontrol_large_rsp,   gbcontrol_large_rsp_reg,   large_rsp_valid[0]);
+      PushRsp(layerreduce_large_rsp, layerreduce_large_rsp_reg, large_rsp_valid[1]);
+      PushRsp(layernorm_large_rsp,   layernorm_large_rsp_reg,   large_rsp_valid[2]);
+      PushRsp(zeropadding_large_rsp, zeropadding_large_rsp_reg, large_rsp_valid[3]);
+      PushRsp(attention_large_rsp,   attention_large_rsp_reg,   large_rsp_valid[4]);
+      PushRsp(gbcontrol_1_large_rsp, gbcontrol_1_large_rsp_reg, large_rsp_valid[5]);
+      
+      #pragma hls_unroll yes    
+      for (int i = 0; i < kNumLargeRequesters; i++) {
+        if (large_grant[i]) {
+          large_req_valid[i] = 0;
+        }
+      }
 
       wait();
     }
@@ -437,7 +675,6 @@ class GBCore : public match::Module {
   void SmallRun() {
     spec::Axi::SlaveToRVA::Write rva_in_reg;
     spec::Axi::SlaveToRVA::Read rva_out_reg;          
-    spec::GB::Small::DataReq small_req_reg;
       
     rva_in_small.Reset();
     rva_out_small.Reset();
@@ -447,32 +684,48 @@ class GBCore : public match::Module {
     layernorm_small_rsp.Reset();   
     attention_small_req.Reset(); 
     attention_small_rsp.Reset(); 
+    gbcontrol_1_small_req.Reset(); 
+    gbcontrol_1_small_rsp.Reset(); 
     
     #pragma hls_unroll yes    
     for (int i = 0; i < spec::GB::Small::kMaxNumManagers; i++) {    
       base_small[i]        = 0;
     }  
+    #pragma hls_unroll yes    
+    for (int i = 0; i < kNumSmallRequesters; i++) {
+      small_req_valid[i] = 0;
+      small_half[i] = 0;
+      small_rsp_valid[i] = 0;
+    }
+    small_arb.Reset();
 
     #pragma hls_pipeline_init_interval 1    
     while(1) {
       NVUINT4 rsp_mode = 0;  
-      bool is_axi = 0;    
-      small_read_addrs          [0] = 0; 
-      small_read_req_valid      [0] = 0;  
-      small_read_ready          [0] = 0;  
+      
+      // banks, read ports and write port taken in this cycle
+      NVUINT4 bank_mask = 0;
+      NVUINT2 num_read = 0;
+      bool is_write_busy = 0;
+      
+      #pragma hls_unroll yes 
+      for (unsigned i = 0; i < spec::GB::Small::kNumReadPorts; i++) { 
+        small_read_addrs          [i] = 0; 
+        small_read_req_valid      [i] = 0;  
+        small_read_ready          [i] = 0;  
+      }
       small_write_addrs         [0] = 0;
       small_write_req_valid     [0] = 0;
       small_write_data          [0] = 0;
 
-
-      
+      // AXI has the highest priority but only takes the bank it accesses
       if (rva_in_small.PopNB(rva_in_reg)) {
         NVUINT4     tmp = nvhls::get_slc<4>(rva_in_reg.addr, 20);
         NVUINT16    local_index = nvhls::get_slc<16>(rva_in_reg.addr, 4);
-        is_axi = 1;
+        spec::GB::Small::Address axi_addr = SmallSwizzle(local_index);
+        spec::GB::Small::BankIndex axi_bank = GetSmallBank(axi_addr);
         if(rva_in_reg.rw) {
           CDCOUT(sc_time_stamp()  << " GBCore Small: " << name() << "RVA Write " << endl, kDebugLevel);    
-          //NVUINT1 preload_idx = !pe_config.active_idx;
 
           switch (tmp) {
             case 0x4: {    
@@ -482,12 +735,17 @@ class GBCore : public match::Module {
                   base_small[i]        = nvhls::get_slc<16>(rva_in_reg.data, 16*i);
                 } 
               }
+              else if (local_index == 0x04) {
+                small_arb.ConfigWrite(rva_in_reg.data);
+              }
               break;
             }
             case 0x6: {    
-              small_write_addrs         [0] = local_index;
+              small_write_addrs         [0] = axi_addr;
               small_write_req_valid     [0] = 1;
               small_write_data          [0] = rva_in_reg.data; 
+              bank_mask[axi_bank] = 1;
+              is_write_busy = 1;
               break;
             }
             default: {
@@ -506,13 +764,16 @@ class GBCore : public match::Module {
                   rva_out_reg.data.set_slc<16>(16*i, base_small[i]);
                 }
               }
+              else if (local_index == 0x04) {
+                small_arb.ConfigRead(rva_out_reg.data);
+              }
               rsp_mode = 0x4; 
               break;           
             }
             case 0x6: {    
-              small_read_addrs          [0] = local_index;
-              small_read_req_valid      [0] = 1;   
-              small_read_ready          [0] = 1;
+              SetSmallRead(0, axi_addr);
+              bank_mask[axi_bank] = 1;
+              num_read = 1;
               rsp_mode = 0x6;
               break;
             }
@@ -523,45 +784,42 @@ class GBCore : public match::Module {
         }
       }
       
-      NVUINT3 valid_regs = 0; 
-      NVUINT3 pos = 0;
-      spec::GB::Small::DataReq small_req_regs[5];         
-      if (is_axi == 0) {
-        valid_regs[0] = gbcontrol_small_req.  PopNB(small_req_regs[0]);
-        valid_regs[1] = layernorm_small_req.  PopNB(small_req_regs[1]);
-        valid_regs[2] = attention_small_req.  PopNB(small_req_regs[2]);
-               
-      // 2. leading one detect
-        pos = nvhls::leading_ones<3, NVUINT3, NVUINT3>(valid_regs); 
-      }
-      
+      // 1. PopNB into the empty request slots
+      if (!small_req_valid[0]) small_req_valid[0] = gbcontrol_small_req.  PopNB(small_req_regs[0]);
+      if (!small_req_valid[1]) small_req_valid[1] = layernorm_small_req.  PopNB(small_req_regs[1]);
+      if (!small_req_valid[2]) small_req_valid[2] = attention_small_req.  PopNB(small_req_regs[2]);
+      if (!small_req_valid[3]) small_req_valid[3] = gbcontrol_1_small_req.PopNB(small_req_regs[3]);
       
-      
-      if (valid_regs != 0) {
-        spec::GB::Small::DataReq small_req_reg = small_req_regs[pos];
-        switch(pos){ 
-          case 0:
-            SetSmallBuffer(small_req_reg);
-            if (!small_req_reg.is_write) {
-              rsp_mode = 0x7;      
-            }          
-            break;
-          case 1:
-            SetSmallBuffer(small_req_reg);
-            if (!small_req_reg.is_write) {
-              rsp_mode = 0x9;      
-            }           
-            break;    
-          case 2:
-            SetSmallBuffer(small_req_reg);   
-            if (!small_req_reg.is_write) {
-              rsp_mode = 0xB;
-            }          
-            break;
-          default:        
-            break;          
+      // 2. grant every request without bank/port conflict, 
+      //   high priority requesters (small_arb) first then the others
+      bool    small_ready   [kNumSmallRequesters];
+      bool    small_grant   [kNumSmallRequesters];
+      bool    small_high    [kNumSmallRequesters];
+      bool    small_get_1   [kNumSmallRequesters];
+      bool    small_get_2   [kNumSmallRequesters];
+      NVUINT1 small_port_1  [kNumSmallRequesters];
+      NVUINT1 small_port_2  [kNumSmallRequesters];
+      small_arb.GetPriority(small_high);
+      #pragma hls_unroll yes    
+      for (int i = 0; i < kNumSmallRequesters; i++) {
+        small_ready[i] = IsSmallReqReady(i);
+        small_grant[i] = 0;
+        small_get_1[i] = 0;
+        small_get_2[i] = 0;
+        small_port_1[i] = 0;
+        small_port_2[i] = 0;
+      }
+      #pragma hls_unroll yes    
+      for (int pass = 0; pass < 2; pass++) {
+        #pragma hls_unroll yes    
+        for (int i = 0; i < kNumSmallRequesters; i++) {
+          if (small_ready[i] && (small_high[i] == (pass == 0))) {
+            small_grant[i] = GrantSmall(i, bank_mask, num_read, is_write_busy, 
+                                        small_get_1[i], small_get_2[i], small_port_1[i], small_port_2[i]);
+          }
         }
-      }      
+      }
+      small_arb.Update(small_ready, small_grant, small_high);
       
       small_mem.run(
         small_read_addrs          , 
@@ -587,28 +845,34 @@ class GBCore : public match::Module {
           rva_out_small.Push(rva_out_reg);        
           break;        
         }
-        case 0x7: { // GBControl
-          spec::GB::Small::DataRsp  small_rsp_reg;
-          small_rsp_reg.read_data = small_port_read_out[0];
-          gbcontrol_small_rsp.Push(small_rsp_reg);
+        default: {
           break;
         }
-        case 0x9: { // LayerNorm
-          spec::GB::Small::DataRsp  small_rsp_reg;
-          small_rsp_reg.read_data = small_port_read_out[0];
-          layernorm_small_rsp.Push(small_rsp_reg);  
-          break;
+      }    
+      
+      // 3. collect read data, respond to the completed requests (held until taken)
+      #pragma hls_unroll yes    
+      for (int i = 0; i < kNumSmallRequesters; i++) {
+        if (small_get_1[i]) {
+          small_rsp_regs[i].read_data = small_port_read_out[small_port_1[i]];
         }
-        case 0xB: { // TODO attention start 
-          spec::GB::Small::DataRsp  small_rsp_reg;
-          small_rsp_reg.read_data = small_port_read_out[0];
-          attention_small_rsp.Push(small_rsp_reg);          
-          break; 
+        if (small_get_2[i]) {
+          small_rsp_regs[i].read_data_2 = small_port_read_out[small_port_2[i]];
         }
-        default: {
-          break;
+        if (small_grant[i]) {
+          small_req_valid[i] = 0;
+          small_half[i] = 0;
+          small_rsp_valid[i] = !small_req_regs[i].is_write;
         }
-      }    
+        else if (small_get_1[i]) {
+          small_half[i] = 1;
+        }
+      }
+      
+      PushRsp(gbcontrol_small_rsp,   small_rsp_regs[0], small_rsp_valid[0]);  // GBControl
+      PushRsp(layernorm_small_rsp,   small_rsp_regs[1], small_rsp_valid[1]);  // LayerNorm
+      PushRsp(attention_small_rsp,   small_rsp_regs[2], small_rsp_valid[2]);  // Attention
+      PushRsp(gbcontrol_1_small_rsp, small_rsp_regs[3], small_rsp_valid[3]);  // GBControl (PE group 1)
       
       wait();
     }
@@ -49,6 +49,8 @@ class GBRVA : public match::Module {
   Connections::Out<bool> layernorm_start;
   Connections::Out<bool> zeropadding_start;
   Connections::Out<bool> attention_start; 
+  Connections::Out<bool> gbcontrol_1_start;
+  Connections::Out<bool> gbcontrol_pair_start;  // both GBControls started together, to GBDone
   // 4, 5, 6
   Connections::Out<spec::Axi::SlaveToRVA::Write>    gbcore_large_rva_in;
   Connections::In<spec::Axi::SlaveToRVA::Read>      gbcore_large_rva_out; 
@@ -71,8 +73,13 @@ class GBRVA : public match::Module {
   // B TODO: For Attention module
   Connections::Out<spec::Axi::SlaveToRVA::Write>    attention_rva_in;
   Connections::In<spec::Axi::SlaveToRVA::Read>      attention_rva_out;   
+  // C GBControl of PE group 1
+  Connections::Out<spec::Axi::SlaveToRVA::Write>    gbcontrol_1_rva_in;
+  Connections::In<spec::Axi::SlaveToRVA::Read>      gbcontrol_1_rva_out;   
     
   sc_out<NVUINT32> SC_SRAM_CONFIG;  
+  sc_out<spec::PEMaskType> SC_PE_GROUP;  
+  sc_out<spec::GB::Large::ValidLengthType> SC_VALID_LENGTH;   // 0x4 local 0x05, sampled by the modules at start
   
   // Constructor
   GBRVA (sc_module_name nm)
@@ -84,6 +91,8 @@ class GBRVA : public match::Module {
         layernorm_start("layernorm_start"),
         zeropadding_start("zeropadding_start"),
         attention_start("attention_start"),
+        gbcontrol_1_start("gbcontrol_1_start"),
+        gbcontrol_pair_start("gbcontrol_pair_start"),
         gbcore_large_rva_in("gbcore_large_rva_in"),
         gbcore_large_rva_out("gbcore_large_rva_out"),
         gbcore_small_rva_in("gbcore_small_rva_in"),
@@ -98,7 +107,12 @@ class GBRVA : public match::Module {
         zeropadding_rva_in("zeropadding_rva_in"),
         zeropadding_rva_out("zeropadding_rva_out"),
         attention_rva_in("attention_rva_in"),
-        attention_rva_out("attention_rva_out")
+        attention_rva_out("attention_rva_out"),
+        gbcontrol_1_rva_in("gbcontrol_1_rva_in"),
+        gbcontrol_1_rva_out("gbcontrol_1_rva_out"),
+        SC_SRAM_CONFIG("SC_SRAM_CONFIG"),
+        SC_PE_GROUP("SC_PE_GROUP"),
+        SC_VALID_LENGTH("SC_VALID_LENGTH")
   {
     SC_THREAD(RVAInRun);
     sensitive << clk.pos();
@@ -118,14 +132,19 @@ class GBRVA : public match::Module {
     layernorm_rva_in.Reset();    
     zeropadding_rva_in.Reset();  
     attention_rva_in.Reset();
+    gbcontrol_1_rva_in.Reset();
     
     gbcontrol_start.Reset();
     layerreduce_start.Reset();
     layernorm_start.Reset();
     zeropadding_start.Reset();
     attention_start.Reset();
+    gbcontrol_1_start.Reset();
+    gbcontrol_pair_start.Reset();
     
     SC_SRAM_CONFIG.write(0);
+    SC_PE_GROUP.write(0);
+    SC_VALID_LENGTH.write(0);
 
     #pragma hls_pipeline_init_interval 1    
     while(1){
@@ -164,6 +183,14 @@ class GBRVA : public match::Module {
               case 0x5: // TODO attention start 
                 attention_start.Push(1);
                 break; 
+              case 0x6:
+                gbcontrol_1_start.Push(1);
+                break; 
+              case 0x7: // Bidirectional: both GBControls (e.g. mode 1 and mode 2), one joint done
+                gbcontrol_pair_start.Push(1);
+                gbcontrol_start.Push(1);
+                gbcontrol_1_start.Push(1);
+                break; 
               default:
                 break;
             }
@@ -178,14 +205,31 @@ class GBRVA : public match::Module {
             }
             break;
           case 0x4: {
-            if (local_index == 0x01) {
-              // local 1: Large Buffer Config     
+            if (local_index == 0x01 || local_index == 0x03) {
+              // local 1: Large Buffer Config, local 3: Large Buffer Arbitration
               gbcore_large_rva_in.Push(rva_in_reg);
             }
-            else if (local_index == 0x02) {
-              // local 2: Small Buffer Config            
+            else if (local_index == 0x02 || local_index == 0x04) {
+              // local 2: Small Buffer Config, local 4: Small Buffer Arbitration            
               gbcore_small_rva_in.Push(rva_in_reg);            
             } 
+            else if (local_index == 0x05) {
+              // local 5: Large Buffer valid length, also used by the modules to bound their loops,
+              //   a signal so that a write never waits for a running module
+              gbcore_large_rva_in.Push(rva_in_reg);
+              if (rva_in_reg.rw) {
+                SC_VALID_LENGTH.write(nvhls::get_slc<16*spec::GB::Large::kMaxNumManagers>(rva_in_reg.data, 0));
+              }
+            }
+            else if (local_index == 0x06) {
+              // local 6: PE group of each PE (bit i for PE i), read back through GBCore
+              if (rva_in_reg.rw) {
+                SC_PE_GROUP.write(nvhls::get_slc<spec::kNumPE>(rva_in_reg.data, 0));
+              } 
+              else {
+                gbcore_large_rva_in.Push(rva_in_reg);
+              }
+            }
             break;
           }
           case 0x5: 
@@ -211,6 +255,9 @@ class GBRVA : public match::Module {
           case 0xB: // Attehtion
             attention_rva_in.Push(rva_in_reg);
             break;         
+          case 0xC: // GBControl of PE group 1
+            gbcontrol_1_rva_in.Push(rva_in_reg);
+            break;         
           default: 
             break;
         }              
@@ -227,6 +274,7 @@ class GBRVA : public match::Module {
     layernorm_rva_out.Reset(); 
     zeropadding_rva_out.Reset(); 
     attention_rva_out.Reset(); 
+    gbcontrol_1_rva_out.Reset(); 
 
     #pragma hls_pipeline_init_interval 1
     while(1){
@@ -254,6 +302,9 @@ class GBRVA : public match::Module {
       else if (attention_rva_out.PopNB(rva_out_reg)) {
         is_valid = 1;
       }
+      else if (gbcontrol_1_rva_out.PopNB(rva_out_reg)) {
+        is_valid = 1;
+      }
       
       if (is_valid) {
         rva_out.Push(rva_out_reg);
@@ -273,6 +324,8 @@ class GBDone : public match::Module {
   Connections::In<bool> layernorm_done;
   Connections::In<bool> zeropadding_done; 
   Connections::In<bool> attention_done;   
+  Connections::In<bool> gbcontrol_1_done;   
+  Connections::In<bool> gbcontrol_pair_start;   
   
    // Constructor
   GBDone (sc_module_name nm)
@@ -281,7 +334,9 @@ class GBDone : public match::Module {
         layerreduce_done("layerreduce_done"), 
         layernorm_done("layernorm_done"),
         zeropadding_done("zeropadding_done"),
-        attention_done("attention_done")
+        attention_done("attention_done"),
+        gbcontrol_1_done("gbcontrol_1_done"),
+        gbcontrol_pair_start("gbcontrol_pair_start")
   {
     SC_THREAD(GBDoneRun);
     sensitive << clk.pos();
@@ -295,12 +350,30 @@ class GBDone : public match::Module {
     layernorm_done.Reset();
     zeropadding_done.Reset(); 
     attention_done.Reset();
+    gbcontrol_1_done.Reset();
+    gbcontrol_pair_start.Reset();
+    
+    // Joint start of both GBControls: a single done once both are done
+    bool is_pair = 0;
+    bool is_pair_done[spec::kNumPEGroups];
+    #pragma hls_unroll yes
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      is_pair_done[g] = 0;
+    }
 
     #pragma hls_pipeline_init_interval 1
     while(1) {
       bool is_done = 0, done_reg = 0;
-      if (gbcontrol_done.PopNB(done_reg)) {
-        is_done = 1;
+      if (gbcontrol_pair_start.PopNB(done_reg)) {
+        is_pair = 1;
+        #pragma hls_unroll yes
+        for (int g = 0; g < spec::kNumPEGroups; g++) {
+          is_pair_done[g] = 0;
+        }
+      }
+      else if (gbcontrol_done.PopNB(done_reg)) {
+        if (is_pair) is_pair_done[0] = 1;
+        else is_done = 1;
       }
       else if (layerreduce_done.PopNB(done_reg)) {
         is_done = 1;
@@ -314,6 +387,14 @@ class GBDone : public match::Module {
       else if (attention_done.PopNB(done_reg)) {
         is_done = 1;
       }
+      else if (gbcontrol_1_done.PopNB(done_reg)) {
+        if (is_pair) is_pair_done[1] = 1;
+        else is_done = 1;
+      }
+      if (is_pair && is_pair_done[0] && is_pair_done[1]) {
+        is_pair = 0;
+        is_done = 1;
+      }
       if (is_done == 1){
         done.Push(1);       
       }
@@ -322,6 +403,154 @@ class GBDone : public match::Module {
   }
 };
 
+// Layer pipelining: merges the streams of the GBControl of each PE group to the 
+//   PEs (tagged with the group), and returns the PE outputs to the GBControl of their group.
+//   PE start (done) of a group is forwarded after the data streamed before it, 
+//   so that start/done cannot overtake the data (see DataBus)
+class GBStream : public match::Module { 
+  static const int kDebugLevel = 3;
+  SC_HAS_PROCESS(GBStream);
+ public: 
+  Connections::In<spec::StreamType>   gbcontrol_data_out[spec::kNumPEGroups];
+  Connections::Out<spec::StreamType>  gbcontrol_data_in[spec::kNumPEGroups];
+  Connections::Out<spec::StreamType>  data_out;
+  Connections::In<spec::StreamType>   data_in;
+  Connections::In<bool>               gbcontrol_pe_start[spec::kNumPEGroups];
+  Connections::Out<bool>              gbcontrol_pe_done[spec::kNumPEGroups];
+  Connections::Out<bool>              pe_start[spec::kNumPEGroups];
+  Connections::In<bool>               pe_done[spec::kNumPEGroups];
+  sc_in<spec::PEMaskType>             pe_done_status;
+  sc_out<spec::PEMaskType>            gbcontrol_pe_done_status;   // updated after the PE outputs before it
+  
+   // Constructor
+  GBStream (sc_module_name nm)
+      : match::Module(nm),
+        data_out("data_out"),
+        data_in("data_in"),
+        pe_done_status("pe_done_status"),
+        gbcontrol_pe_done_status("gbcontrol_pe_done_status")
+  {
+    SC_THREAD(SendRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+    
+    SC_THREAD(RecvRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }    
+  
+  void SendRun() {
+    #pragma hls_unroll yes
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      gbcontrol_data_out[g].Reset();
+      gbcontrol_pe_start[g].Reset();
+      pe_start[g].Reset();
+    }
+    data_out.Reset();
+    
+    spec::StreamType  data_out_regs[spec::kNumPEGroups];
+    bool              data_out_valid[spec::kNumPEGroups];
+    spec::PEGroupType last_group = 1;
+    #pragma hls_unroll yes
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      data_out_valid[g] = 0;
+    }
+
+    #pragma hls_pipeline_init_interval 1
+    while(1) {
+      #pragma hls_unroll yes
+      for (int g = 0; g < spec::kNumPEGroups; g++) {
+        if (!data_out_valid[g]) data_out_valid[g] = gbcontrol_data_out[g].PopNB(data_out_regs[g]);
+      }
+      
+      // alternate between the groups when both are streaming
+      if (data_out_valid[0] || data_out_valid[1]) {
+        spec::PEGroupType group = data_out_valid[1];
+        if (data_out_valid[0] && data_out_valid[1]) {
+          group = ~last_group;
+        }
+        spec::StreamType data_out_reg = data_out_regs[group];
+        data_out_reg.group = group;
+        data_out.Push(data_out_reg);
+        data_out_valid[group] = 0;
+        last_group = group;
+      }
+      
+      // GBControl pushes the start after its stream, which has been popped here
+      #pragma hls_unroll yes
+      for (int g = 0; g < spec::kNumPEGroups; g++) {
+        bool pe_start_reg;
+        if (!data_out_valid[g] && gbcontrol_pe_start[g].PopNB(pe_start_reg)) {
+          pe_start[g].Push(1);
+        }
+      }
+      wait();
+    }
+  }
+  
+  void RecvRun() {
+    #pragma hls_unroll yes
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      gbcontrol_data_in[g].Reset();
+      gbcontrol_pe_done[g].Reset();
+      pe_done[g].Reset();
+    }
+    data_in.Reset();
+    gbcontrol_pe_done_status.write(0);
+
+    // PE output popped from data_in, then held per group until its GBControl takes it,
+    //   a stalled GBControl does not block the outputs (done) of the other group
+    spec::StreamType data_in_reg;
+    bool             data_in_valid = 0;
+    spec::StreamType data_in_regs[spec::kNumPEGroups];
+    bool             data_in_held[spec::kNumPEGroups];
+    bool             pe_done_held[spec::kNumPEGroups];
+    #pragma hls_unroll yes
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      data_in_held[g] = 0;
+      pe_done_held[g] = 0;
+    }
+
+    #pragma hls_pipeline_init_interval 1
+    while(1) {
+      // read before the outputs are popped, all outputs of a done PE have been received by then
+      spec::PEMaskType pe_done_status_reg = pe_done_status.read();
+      if (!data_in_valid) {
+        data_in_valid = data_in.PopNB(data_in_reg);
+      }
+      
+      #pragma hls_unroll yes
+      for (int g = 0; g < spec::kNumPEGroups; g++) {
+        if (data_in_valid && (data_in_reg.group == g) && !data_in_held[g]) {
+          data_in_regs[g] = data_in_reg;
+          data_in_held[g] = 1;
+          data_in_valid = 0;
+        }
+        if (data_in_held[g] && gbcontrol_data_in[g].PushNB(data_in_regs[g])) {
+          data_in_held[g] = 0;
+        }
+        
+        // PE outputs before the done have been delivered (GBRecv), the done
+        //   of a group is taken only after its outputs have been pushed above
+        bool is_pending = data_in_held[g] || (data_in_valid && (data_in_reg.group == g));
+        bool pe_done_reg;
+        if (!pe_done_held[g] && !is_pending) {
+          pe_done_held[g] = pe_done[g].PopNB(pe_done_reg);
+        }
+        if (pe_done_held[g] && gbcontrol_pe_done[g].PushNB(1)) {
+          pe_done_held[g] = 0;
+        }
+      }
+      
+      // only once the outputs read before it have been pushed
+      if (!data_in_valid && !data_in_held[0] && !data_in_held[1]) {
+        gbcontrol_pe_done_status.write(pe_done_status_reg);
+      }
+      wait();
+    }
+  }
+};
+
 
 // GB module does not handle the distribution of workloads across PEs, that part is implements 
 class GBModule : public match::Module { 
@@ -337,6 +566,11 @@ class GBModule : public match::Module {
   Connections::Out<spec::StreamType>  data_out;
   Connections::Out<bool>              pe_start;
   Connections::In<bool>               pe_done;  
+  // Layer pipelining: start/done of PE group 1, and the group of each PE
+  Connections::Out<bool>              pe_start_1;
+  Connections::In<bool>               pe_done_1;  
+  sc_out<spec::PEMaskType>            pe_group;
+  sc_in<spec::PEMaskType>             pe_done_status;   // PEs done with the current timestep
   
   
   // GBCore 3, 4, 5, 6
@@ -359,6 +593,9 @@ class GBModule : public match::Module {
   // TODO: For Attention module B  
   Connections::Combinational<spec::Axi::SlaveToRVA::Write>    attention_rva_in;
   Connections::Combinational<spec::Axi::SlaveToRVA::Read>     attention_rva_out;     
+  // GBControl of PE group 1 C
+  Connections::Combinational<spec::Axi::SlaveToRVA::Write>    gbcontrol_1_rva_in;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Read>     gbcontrol_1_rva_out;     
  
  
   Connections::Combinational<bool> gbcontrol_start;
@@ -366,12 +603,15 @@ class GBModule : public match::Module {
   Connections::Combinational<bool> layernorm_start;
   Connections::Combinational<bool> zeropadding_start; 
   Connections::Combinational<bool> attention_start; 
+  Connections::Combinational<bool> gbcontrol_1_start; 
+  Connections::Combinational<bool> gbcontrol_pair_start; 
     
   Connections::Combinational<bool> gbcontrol_done;
   Connections::Combinational<bool> layerreduce_done;
   Connections::Combinational<bool> layernorm_done;
   Connections::Combinational<bool> zeropadding_done; 
   Connections::Combinational<bool> attention_done;   
+  Connections::Combinational<bool> gbcontrol_1_done;   
   
   // GBControl
   Connections::Combinational<spec::GB::Large::DataReq>      gbcontrol_large_req;
@@ -380,7 +620,7 @@ class GBModule : public match::Module {
   Connections::Combinational<spec::GB::Small::DataRsp>      gbcontrol_small_rsp;
   // LayerReduce
   Connections::Combinational<spec::GB::Large::DataReq>      layerreduce_large_req;
-  Connections::Combinational<spec::GB::Large::DataRsp<2>>   layerreduce_large_rsp;  
+  Connections::Combinational<spec::GB::Large::DataRsp<8>>   layerreduce_large_rsp;  
   // layerNorm
   Connections::Combinational<spec::GB::Large::DataReq>      layernorm_large_req;
   Connections::Combinational<spec::GB::Large::DataRsp<1>>   layernorm_large_rsp;  
@@ -394,13 +634,27 @@ class GBModule : public match::Module {
   Connections::Combinational<spec::GB::Large::DataRsp<16>>  attention_large_rsp;   
   Connections::Combinational<spec::GB::Small::DataReq>       attention_small_req;
   Connections::Combinational<spec::GB::Small::DataRsp>      attention_small_rsp;   
-
+  // GBControl of PE group 1
+  Connections::Combinational<spec::GB::Large::DataReq>      gbcontrol_1_large_req;
+  Connections::Combinational<spec::GB::Large::DataRsp<1>>   gbcontrol_1_large_rsp;  
+  Connections::Combinational<spec::GB::Small::DataReq>      gbcontrol_1_small_req;
+  Connections::Combinational<spec::GB::Small::DataRsp>      gbcontrol_1_small_rsp;
+  
+  // GBControl <-> GBStream
+  Connections::Combinational<spec::StreamType>  gbcontrol_data_out[spec::kNumPEGroups];
+  Connections::Combinational<spec::StreamType>  gbcontrol_data_in[spec::kNumPEGroups];
+  Connections::Combinational<bool>              gbcontrol_pe_start[spec::kNumPEGroups];
+  Connections::Combinational<bool>              gbcontrol_pe_done[spec::kNumPEGroups];
+  sc_signal<NVUINT16> timestep_progress[spec::kNumPEGroups];
+  sc_signal<spec::PEMaskType> gbcontrol_pe_done_status;
 
   
   sc_signal<NVUINT32> SC_SRAM_CONFIG;
+  sc_signal<spec::GB::Large::ValidLengthType> SC_VALID_LENGTH;
   
   GBRVA         gbrva_inst;
   GBDone        gbdone_inst;
+  GBStream      gbstream_inst;
   
   GBCore        gbcore_inst; 
   GBControl     gbcontrol_inst; 
@@ -408,6 +662,7 @@ class GBModule : public match::Module {
   LayerNorm     layernorm_inst;
   ZeroPadding   zeropadding_inst;
   Attention     attention_inst;
+  GBControl     gbcontrol_1_inst; 
   
   
   GBModule(sc_module_name nm)
@@ -420,6 +675,10 @@ class GBModule : public match::Module {
         data_out  ("data_out"),
         pe_start  ("pe_start"),
         pe_done   ("pe_done"),
+        pe_start_1("pe_start_1"),
+        pe_done_1 ("pe_done_1"),
+        pe_group  ("pe_group"),
+        pe_done_status("pe_done_status"),
         
         gbcore_large_rva_in       ("gbcore_large_rva_in"),
         gbcore_large_rva_out      ("gbcore_large_rva_out"), 
@@ -436,18 +695,23 @@ class GBModule : public match::Module {
         zeropadding_rva_out ("zeropadding_rva_out"),
         attention_rva_in    ("attention_rva_in"),
         attention_rva_out   ("attention_rva_out"),
+        gbcontrol_1_rva_in  ("gbcontrol_1_rva_in"),
+        gbcontrol_1_rva_out ("gbcontrol_1_rva_out"),
         
         gbcontrol_start     ("gbcontrol_start"),
         layerreduce_start   ("layerreduce_start"),
         layernorm_start     ("layernorm_start"),
         zeropadding_start   ("zeropadding_start"), 
         attention_start     ("attention_start"),        
+        gbcontrol_1_start   ("gbcontrol_1_start"),
+        gbcontrol_pair_start("gbcontrol_pair_start"),
         
         gbcontrol_done      ("gbcontrol_done"),
         layerreduce_done    ("layerreduce_done"),
         layernorm_done      ("layernorm_done"),
         zeropadding_done    ("zeropadding_done"),         
         attention_done      ("attention_done"),
+        gbcontrol_1_done    ("gbcontrol_1_done"),
         
         //GB Control, LayerReduce, LayerNorm, ZeroPadding
         gbcontrol_large_req   ("gbcontrol_large_req"),
@@ -470,17 +734,25 @@ class GBModule : public match::Module {
         attention_large_rsp ("attention_large_rsp"),
         attention_small_req ("attention_small_req"),
         attention_small_rsp ("attention_small_rsp"),
+        
+        gbcontrol_1_large_req ("gbcontrol_1_large_req"),
+        gbcontrol_1_large_rsp ("gbcontrol_1_large_rsp"),  
+        gbcontrol_1_small_req ("gbcontrol_1_small_req"),
+        gbcontrol_1_small_rsp ("gbcontrol_1_small_rsp"), 
                 
         SC_SRAM_CONFIG("SC_SRAM_CONFIG"),
+        SC_VALID_LENGTH("SC_VALID_LENGTH"),
         
         gbrva_inst("gbrva_inst"),
         gbdone_inst("gbdone_inst"),
+        gbstream_inst("gbstream_inst"),
         gbcore_inst("gbcore_inst"),
 	gbcontrol_inst("gbcontrol_inst"), 
 	layerreduce_inst("layerreduce_inst"),
 	layernorm_inst("layernorm_inst"),
         zeropadding_inst("zeropadding_inst"),
-        attention_inst("attention_inst")
+        attention_inst("attention_inst"),
+        gbcontrol_1_inst("gbcontrol_1_inst")
   {
     //gbrva_inst
     gbrva_inst.clk(clk);
@@ -492,6 +764,8 @@ class GBModule : public match::Module {
     gbrva_inst.layernorm_start(layernorm_start);
     gbrva_inst.zeropadding_start(zeropadding_start);
     gbrva_inst.attention_start(attention_start);
+    gbrva_inst.gbcontrol_1_start(gbcontrol_1_start);
+    gbrva_inst.gbcontrol_pair_start(gbcontrol_pair_start);
     
     gbrva_inst.gbcore_large_rva_in      (gbcore_large_rva_in);
     gbrva_inst.gbcore_large_rva_out     (gbcore_large_rva_out); 
@@ -508,9 +782,13 @@ class GBModule : public match::Module {
     gbrva_inst.zeropadding_rva_out(zeropadding_rva_out);  
     gbrva_inst.attention_rva_in   (attention_rva_in);
     gbrva_inst.attention_rva_out  (attention_rva_out);  
+    gbrva_inst.gbcontrol_1_rva_in (gbcontrol_1_rva_in);
+    gbrva_inst.gbcontrol_1_rva_out(gbcontrol_1_rva_out);  
         
           
     gbrva_inst.SC_SRAM_CONFIG(SC_SRAM_CONFIG);
+    gbrva_inst.SC_PE_GROUP(pe_group);
+    gbrva_inst.SC_VALID_LENGTH(SC_VALID_LENGTH);
     
     
     //gbdone_inst
@@ -522,6 +800,25 @@ class GBModule : public match::Module {
     gbdone_inst.layernorm_done(layernorm_done);
     gbdone_inst.zeropadding_done(zeropadding_done);    
     gbdone_inst.attention_done(attention_done);
+    gbdone_inst.gbcontrol_1_done(gbcontrol_1_done);
+    gbdone_inst.gbcontrol_pair_start(gbcontrol_pair_start);
+    //gbstream_inst
+    gbstream_inst.clk(clk);
+    gbstream_inst.rst(rst);
+    gbstream_inst.data_out(data_out);
+    gbstream_inst.data_in(data_in);
+    for (int g = 0; g < spec::kNumPEGroups; g++) {
+      gbstream_inst.gbcontrol_data_out[g](gbcontrol_data_out[g]);
+      gbstream_inst.gbcontrol_data_in[g](gbcontrol_data_in[g]);
+      gbstream_inst.gbcontrol_pe_start[g](gbcontrol_pe_start[g]);
+      gbstream_inst.gbcontrol_pe_done[g](gbcontrol_pe_done[g]);
+    }
+    gbstream_inst.pe_start[0](pe_start);
+    gbstream_inst.pe_done[0](pe_done);
+    gbstream_inst.pe_start[1](pe_start_1);
+    gbstream_inst.pe_done[1](pe_done_1);
+    gbstream_inst.pe_done_status(pe_done_status);
+    gbstream_inst.gbcontrol_pe_done_status(gbcontrol_pe_done_status);
     //gbcore_inst
     gbcore_inst.clk                   (clk);
     gbcore_inst.rst                   (rst);
@@ -547,8 +844,13 @@ class GBModule : public match::Module {
     gbcore_inst.attention_large_rsp   (attention_large_rsp);      
     gbcore_inst.attention_small_req   (attention_small_req);
     gbcore_inst.attention_small_rsp   (attention_small_rsp); 
+    gbcore_inst.gbcontrol_1_large_req (gbcontrol_1_large_req);
+    gbcore_inst.gbcontrol_1_large_rsp (gbcontrol_1_large_rsp);  
+    gbcore_inst.gbcontrol_1_small_req (gbcontrol_1_small_req);
+    gbcore_inst.gbcontrol_1_small_rsp (gbcontrol_1_small_rsp);
       
     gbcore_inst.SC_SRAM_CONFIG(SC_SRAM_CONFIG);
+    gbcore_inst.SC_PE_GROUP(pe_group);
     
     //gbcontrol_inst
     gbcontrol_inst.clk        (clk); 
@@ -561,10 +863,34 @@ class GBModule : public match::Module {
     gbcontrol_inst.large_rsp  (gbcontrol_large_rsp);
     gbcontrol_inst.small_req  (gbcontrol_small_req);
     gbcontrol_inst.small_rsp  (gbcontrol_small_rsp);
-    gbcontrol_inst.data_out   (data_out);
-    gbcontrol_inst.data_in    (data_in);
-    gbcontrol_inst.pe_start   (pe_start);
-    gbcontrol_inst.pe_done    (pe_done);
+    gbcontrol_inst.data_out   (gbcontrol_data_out[0]);
+    gbcontrol_inst.data_in    (gbcontrol_data_in[0]);
+    gbcontrol_inst.pe_start   (gbcontrol_pe_start[0]);
+    gbcontrol_inst.pe_done    (gbcontrol_pe_done[0]);
+    gbcontrol_inst.timestep_progress(timestep_progress[0]);
+    gbcontrol_inst.follow_progress  (timestep_progress[1]);
+    gbcontrol_inst.pe_done_status   (gbcontrol_pe_done_status);
+    gbcontrol_inst.valid_length     (SC_VALID_LENGTH);
+    
+    //gbcontrol_1_inst
+    gbcontrol_1_inst.clk        (clk); 
+    gbcontrol_1_inst.rst        (rst); 
+    gbcontrol_1_inst.rva_in     (gbcontrol_1_rva_in);
+    gbcontrol_1_inst.rva_out    (gbcontrol_1_rva_out);
+    gbcontrol_1_inst.start      (gbcontrol_1_start);
+    gbcontrol_1_inst.done       (gbcontrol_1_done);
+    gbcontrol_1_inst.large_req  (gbcontrol_1_large_req);
+    gbcontrol_1_inst.large_rsp  (gbcontrol_1_large_rsp);
+    gbcontrol_1_inst.small_req  (gbcontrol_1_small_req);
+    gbcontrol_1_inst.small_rsp  (gbcontrol_1_small_rsp);
+    gbcontrol_1_inst.data_out   (gbcontrol_data_out[1]);
+    gbcontrol_1_inst.data_in    (gbcontrol_data_in[1]);
+    gbcontrol_1_inst.pe_start   (gbcontrol_pe_start[1]);
+    gbcontrol_1_inst.pe_done    (gbcontrol_pe_done[1]);
+    gbcontrol_1_inst.timestep_progress(timestep_progress[1]);
+    gbcontrol_1_inst.follow_progress  (timestep_progress[0]);
+    gbcontrol_1_inst.pe_done_status   (gbcontrol_pe_done_status);
+    gbcontrol_1_inst.valid_length     (SC_VALID_LENGTH);
     
     //layerreduce_inst
     layerreduce_inst.clk      (clk);
@@ -575,6 +901,7 @@ class GBModule : public match::Module {
     layerreduce_inst.done     (layerreduce_done);
     layerreduce_inst.large_req(layerreduce_large_req);
     layerreduce_inst.large_rsp(layerreduce_large_rsp);  
+    layerreduce_inst.valid_length(SC_VALID_LENGTH);
         
     //layernorm_inst
     layernorm_inst.clk        (clk);
@@ -587,6 +914,7 @@ class GBModule : public match::Module {
     layernorm_inst.large_rsp  (layernorm_large_rsp);  
     layernorm_inst.small_req  (layernorm_small_req);
     layernorm_inst.small_rsp  (layernorm_small_rsp);      
+    layernorm_inst.valid_length(SC_VALID_LENGTH);
         
     //zeropadding_inst
     zeropadding_inst.clk        (clk);
@@ -608,6 +936,7 @@ class GBModule : public match::Module {
     attention_inst.large_rsp  (attention_large_rsp);
     attention_inst.small_req  (attention_small_req);
     attention_inst.small_rsp  (attention_small_rsp);
+    attention_inst.valid_length(SC_VALID_LENGTH);
   }
   
 };
@@ -36,18 +36,34 @@
 // vector divide
 // also need sqrt 
 
-// Initial Interval should be II = 2
+// Single pass (num_vector_1 <= kNumCacheVectors): 
+//   READ keeps the vectors of one timestep in x_cache, OUTPUT normalizes them 
+//   with one dual gamma/beta read, both stream one vector per cycle (II = 1)
+// Otherwise the timestep is read twice (MEAN/MEAN2, NORM/NORM2)
+// is_residual: each read of memory_index_1 is followed by a read of memory_index_2 (adpbias_2),
+//   added in fixed point before normalization, the sum is not written back
 
 class LayerNorm : public match::Module {
   static const int kDebugLevel = 4;
   static const int gamma_index = 5;
   static const int beta_index = 6;  
+  static const int kNumCacheVectors = 64;
   SC_HAS_PROCESS(LayerNorm);
   
   spec::LayerNormSumType sum, sqsum;
   spec::ActScalarType mean, inv_std;
   spec::ActVectorType negmean_vector, inv_std_vector;
   spec::ActVectorType out_data;  
+  
+  // Vectors of the current timestep in fixed point
+  spec::ActVectorType x_cache[kNumCacheVectors];
+  // Streaming requests in READ and OUTPUT
+  NVUINT8 issue_counter, return_counter;
+  // Residual operand of the current vector in READ, MEAN and NORM
+  NVUINT1 issue_phase, return_phase;
+  // OUTPUT result not taken by large_req yet, pushed again in the next cycles (PushNB)
+  spec::GB::Large::DataReq write_req_reg;
+  bool is_write_held;
  public:
   Connections::In<spec::Axi::SlaveToRVA::Write> rva_in;
   Connections::Out<spec::Axi::SlaveToRVA::Read> rva_out;
@@ -60,6 +76,10 @@ class LayerNorm : public match::Module {
   
   Connections::Out<spec::GB::Small::DataReq>  small_req;
   Connections::In<spec::GB::Small::DataRsp>   small_rsp;  
+
+  // Valid timesteps of each large buffer region (GBCore 0x4 local 0x05), written by GBRVA,
+  //   sampled at start
+  sc_in<spec::GB::Large::ValidLengthType> valid_length;
   
   
   // The memory index of gramma = 6, beta = 7 
@@ -76,7 +96,8 @@ class LayerNorm : public match::Module {
         large_req("large_req"),
         large_rsp("large_rsp"),
         small_req("small_req"),
-        small_rsp("small_rsp")
+        small_rsp("small_rsp"),
+        valid_length("valid_length")
   {
     SC_THREAD(LayerNormRun);
     sensitive << clk.pos();
@@ -89,7 +110,7 @@ class LayerNorm : public match::Module {
   spec::Axi::SlaveToRVA::Read rva_out_reg;  
   // A. FSM
   enum FSM {
-    IDLE, MEAN, MEAN2, VAR, NORM, NORM2, GAMMA, GAMMA2, BETA, BETA2, BETA3, NEXT
+    IDLE, MEAN, MEAN2, VAR, NORM, NORM2, GAMMA, GAMMA2, WRITE, NEXT, READ, OUTPUT
   };
   FSM state;
   // Find mean first -> var -> norm
@@ -119,6 +140,46 @@ class LayerNorm : public match::Module {
     sqsum = 0;
     mean = 0;
     inv_std = 0;
+    issue_counter = 0;
+    return_counter = 0;
+    issue_phase = 0;
+    return_phase = 0;
+    is_write_held = 0;
+  }
+  
+  bool IsSinglePass() const {
+    return (gbcontrol_config.num_vector_1 <= kNumCacheVectors);
+  }
+  
+  // sum[x] and sum[x^2] of one vector
+  void AccumMeanVar(const spec::ActVectorType x_vector) {
+    spec::ActVectorType sq_vector;
+    spec::ActScalarType tmp_sum, tmp_sqsum;
+    // Get x^2
+    EMul(x_vector, x_vector, sq_vector);
+    // sum[x]
+    VSum(x_vector, tmp_sum);
+    // sum[x^2]
+    VSum(sq_vector, tmp_sqsum);        
+    
+    sum += tmp_sum;
+    sqsum += tmp_sqsum;
+  }
+  
+  // Normalize = (X - E[X])*(Inverse Stdev), then Mul gamma, Add Beta
+  void Normalize(const spec::ActVectorType x_vector, const spec::GB::Small::DataRsp& small_rsp_reg, 
+                 spec::ActVectorType& out_vector) {
+    spec::AdpfloatBiasType adpbias_gamma = gbcontrol_config.adpbias_4;
+    spec::AdpfloatBiasType adpbias_beta = gbcontrol_config.adpbias_3;
+    spec::ActVectorType norm_vector, gamma_vector, beta_vector, vtmp;
+    
+    EAdd (x_vector, negmean_vector, norm_vector);
+    EMul (norm_vector, inv_std_vector, norm_vector);
+    
+    Adpfloat2Fixed(small_rsp_reg.read_data,  gamma_vector, adpbias_gamma);       
+    Adpfloat2Fixed(small_rsp_reg.read_data_2,  beta_vector, adpbias_beta);
+    EMul (norm_vector, gamma_vector, vtmp);        
+    EAdd (vtmp, beta_vector, out_vector);  
   }
   
   void Initialize() {
@@ -183,7 +244,7 @@ class LayerNorm : public match::Module {
         CDCOUT(sc_time_stamp()  << name() << " case MEAN" << endl, kDebugLevel);
         // one pass of Large Buffer read to set mean amd sqmean
         // E[x^2] - [E[x]]^2
-        NVUINT3   memory_index = gbcontrol_config.memory_index_1;
+        NVUINT3   memory_index = (issue_phase == 1) ? gbcontrol_config.memory_index_2 : gbcontrol_config.memory_index_1;
         NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
         NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
         //spec::AdpfloatBiasType adpbias_enc = gbcontrol_config.adpbias_1;
@@ -200,24 +261,70 @@ class LayerNorm : public match::Module {
         CDCOUT(sc_time_stamp()  << name() << " case MEAN2" << endl, kDebugLevel);
         // Receive Rsp        
         spec::AdpfloatBiasType adpbias_enc = gbcontrol_config.adpbias_1;
+        spec::AdpfloatBiasType adpbias_res = gbcontrol_config.adpbias_2;
         spec::GB::Large::DataRsp<1> large_rsp_reg;
         large_rsp_reg = large_rsp.Pop();
 
         spec::ActVectorType x_vector;
-        spec::ActVectorType sq_vector;
-        spec::ActScalarType tmp_sum, tmp_sqsum;
         
         // Get activation vector in ActScalarType
-        Adpfloat2Fixed(large_rsp_reg.read_vector[0],  x_vector, adpbias_enc);       
-        // Get x^2
-        EMul(x_vector, x_vector, sq_vector);
-        // sum[x]
-        VSum(x_vector, tmp_sum);
-        // sum[x^2]
-        VSum(sq_vector, tmp_sqsum);        
+        Adpfloat2Fixed(large_rsp_reg.read_vector[0],  x_vector, (issue_phase == 1) ? adpbias_res : adpbias_enc);       
+        // with is_residual, out_data keeps memory_index_1 until the residual returns
+        if (gbcontrol_config.is_residual && (issue_phase == 0)) {
+          out_data = x_vector;
+        }
+        else {
+          if (gbcontrol_config.is_residual) {
+            EAdd(out_data, x_vector, x_vector);
+          }
+          AccumMeanVar(x_vector);
+        }
+        break;
+      }
+      case READ: {
+        // Stream reads of the whole timestep, each vector is kept in x_cache
+        //   with is_residual, two reads per vector (memory_index_1, then memory_index_2)
+        bool      is_residual = gbcontrol_config.is_residual;
+        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
+        spec::AdpfloatBiasType adpbias_enc = gbcontrol_config.adpbias_1;
+        spec::AdpfloatBiasType adpbias_res = gbcontrol_config.adpbias_2;
+        NVUINT6   cache_index = nvhls::get_slc<6>(return_counter, 0);
         
-        sum += tmp_sum;
-        sqsum += tmp_sqsum;
+        spec::GB::Large::DataRsp<1> large_rsp_reg;
+        if (large_rsp.PopNB(large_rsp_reg)) {
+          spec::ActVectorType x_vector;
+          Adpfloat2Fixed(large_rsp_reg.read_vector[0],  x_vector, (return_phase == 1) ? adpbias_res : adpbias_enc);
+          if (is_residual && (return_phase == 0)) {
+            x_cache[cache_index] = x_vector;
+            return_phase = 1;
+          }
+          else {
+            if (is_residual) {
+              EAdd(x_cache[cache_index], x_vector, x_vector);
+            }
+            AccumMeanVar(x_vector);
+            x_cache[cache_index] = x_vector;
+            return_counter += 1;
+            return_phase = 0;
+          }
+        }
+        
+        if (issue_counter < gbcontrol_config.num_vector_1) {
+          spec::GB::Large::DataReq large_req_reg;
+          large_req_reg.is_write = 0;
+          large_req_reg.memory_index = (issue_phase == 1) ? gbcontrol_config.memory_index_2 : gbcontrol_config.memory_index_1;
+          large_req_reg.vector_index = issue_counter;
+          large_req_reg.timestep_index = timestep_index;
+          if (large_req.PushNB(large_req_reg)) {
+            if (is_residual && (issue_phase == 0)) {
+              issue_phase = 1;
+            }
+            else {
+              issue_counter += 1;
+              issue_phase = 0;
+            }
+          }
+        }
         break;
       }
       case VAR: {
@@ -242,22 +349,24 @@ class LayerNorm : public match::Module {
         spec::ActScalarType var = sqmean - meansq;
         // We use inv_std = 1/sqrt(VAR[X])
         SInvSqrt(var, inv_std);
+        
+        #pragma hls_unroll yes
+        for (int i = 0; i < spec::kVectorSize; i++) {
+          negmean_vector[i] = -mean; // minus mean
+          inv_std_vector[i] = inv_std;
+        }
+        issue_counter = 0;
+        return_counter = 0;
         break;
       }
       case NORM: {
         CDCOUT(sc_time_stamp()  << name() << " case NORM" << endl, kDebugLevel);
-        NVUINT3   memory_index = gbcontrol_config.memory_index_1;
+        NVUINT3   memory_index = (issue_phase == 1) ? gbcontrol_config.memory_index_2 : gbcontrol_config.memory_index_1;
         NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
         NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
         //spec::AdpfloatBiasType adpbias_enc = gbcontrol_config.adpbias_1;
         //out_data = 0;
-        //spec::ActVectorType negmean_vector, inv_std_vector; 
-        
-        #pragma hls_unroll
-        for (int i = 0; i < spec::kVectorSize; i++) {
-          negmean_vector[i] = -mean; // minus mean
-          inv_std_vector[i] = inv_std;
-        }
+        // negmean_vector, inv_std_vector are set in VAR
         
         // Send Req
         spec::GB::Large::DataReq large_req_reg;
@@ -272,79 +381,62 @@ class LayerNorm : public match::Module {
         CDCOUT(sc_time_stamp()  << name() << " case NORM2" << endl, kDebugLevel);
         // Receive Rsp  
         spec::AdpfloatBiasType adpbias_enc = gbcontrol_config.adpbias_1;   
-        out_data = 0;
+        spec::AdpfloatBiasType adpbias_res = gbcontrol_config.adpbias_2;
         //spec::ActVectorType negmean_vector, inv_std_vector;
         spec::GB::Large::DataRsp<1> large_rsp_reg;
         large_rsp_reg = large_rsp.Pop();
        
         spec::ActVectorType x_vector;
-        Adpfloat2Fixed(large_rsp_reg.read_vector[0],  x_vector, adpbias_enc);
+        Adpfloat2Fixed(large_rsp_reg.read_vector[0],  x_vector, (issue_phase == 1) ? adpbias_res : adpbias_enc);
         
-        // Normalize = (X - E[X])*(Inverse Stdev)
-        EAdd (x_vector, negmean_vector, x_vector);
-        EMul (x_vector, inv_std_vector, x_vector);
-        
-        // out_data temporary storage
-        out_data = x_vector;
+        if (gbcontrol_config.is_residual && (issue_phase == 0)) {
+          out_data = x_vector;
+        }
+        else {
+          if (gbcontrol_config.is_residual) {
+            EAdd(out_data, x_vector, x_vector);
+          }
+          // Normalize = (X - E[X])*(Inverse Stdev)
+          EAdd (x_vector, negmean_vector, x_vector);
+          EMul (x_vector, inv_std_vector, x_vector);
+          
+          // out_data temporary storage
+          out_data = x_vector;
+        }
         break;
       }
       case GAMMA: {
         CDCOUT(sc_time_stamp()  << name() << " case GAMMA" << endl, kDebugLevel);
         NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
-        //spec::AdpfloatBiasType adpbias_gamma = gbcontrol_config.adpbias_4;
-        // Get gamma vector
+        // Get gamma and beta vector with one dual read of small buffer
         spec::GB::Small::DataReq small_req_reg;          
         small_req_reg.is_write = 0;
         small_req_reg.memory_index = gamma_index;   // Use 5 
         small_req_reg.vector_index = vector_index;
+        small_req_reg.is_dual = 1;
+        small_req_reg.memory_index_2 = beta_index;  // Use 6
+        small_req_reg.vector_index_2 = vector_index;
         small_req.Push(small_req_reg); 
         break;
       }
       case GAMMA2: { 
         CDCOUT(sc_time_stamp()  << name() << " case GAMMA2" << endl, kDebugLevel);
         spec::AdpfloatBiasType adpbias_gamma = gbcontrol_config.adpbias_4;
+        spec::AdpfloatBiasType adpbias_beta = gbcontrol_config.adpbias_3;
         spec::GB::Small::DataRsp small_rsp_reg;
         small_rsp_reg = small_rsp.Pop();        
         
-        spec::ActVectorType gamma_vector, vtmp;
+        spec::ActVectorType gamma_vector, beta_vector, vtmp;
         Adpfloat2Fixed(small_rsp_reg.read_data,  gamma_vector, adpbias_gamma);       
+        Adpfloat2Fixed(small_rsp_reg.read_data_2,  beta_vector, adpbias_beta);
       
-        // Mul gamma
+        // Mul gamma, Add Beta
         EMul (out_data, gamma_vector, vtmp);        
-        out_data = vtmp;
+        EAdd (vtmp, beta_vector, out_data);  
         break;
       }
-      case BETA: {
-        CDCOUT(sc_time_stamp()  << name() << " case BETA" << endl, kDebugLevel);
-        //NVUINT3   memory_index = gbcontrol_config.memory_index_1;
-        NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
-        //NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
-        //spec::AdpfloatBiasType adpbias_beta = gbcontrol_config.adpbias_3;
-        // Get Beta vector       
-        spec::GB::Small::DataReq small_req_reg;          
-        small_req_reg.is_write = 0;
-        small_req_reg.memory_index = beta_index;    // Use 6
-        small_req_reg.vector_index = vector_index;
-        
-        small_req.Push(small_req_reg); 
-        break;
-      } 
-      case BETA2: {
-        CDCOUT(sc_time_stamp()  << name() << " case BETA2" << endl, kDebugLevel);
-        spec::AdpfloatBiasType adpbias_beta = gbcontrol_config.adpbias_3;
-        spec::GB::Small::DataRsp small_rsp_reg;
-        small_rsp_reg = small_rsp.Pop();              
-
-        spec::ActVectorType beta_vector, vtmp;
-        Adpfloat2Fixed(small_rsp_reg.read_data,  beta_vector, adpbias_beta);
-       
-        // Add Beta
-        EAdd (out_data, beta_vector, vtmp);  
-        out_data = vtmp;
-        break;
-     }
-     case BETA3: {
-        CDCOUT(sc_time_stamp()  << name() << " case BETA3" << endl, kDebugLevel);
+     case WRITE: {
+        CDCOUT(sc_time_stamp()  << name() << " case WRITE" << endl, kDebugLevel);
         spec::AdpfloatBiasType adpbias_enc = gbcontrol_config.adpbias_1;        
         NVUINT3   memory_index = gbcontrol_config.memory_index_1;
         NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
@@ -359,6 +451,44 @@ class LayerNorm : public match::Module {
         large_req.Push(large_req_reg);               
         break;
       }
+      case OUTPUT: {
+        // Stream gamma/beta reads, each response normalizes the cached vector and writes it back
+        spec::AdpfloatBiasType adpbias_enc = gbcontrol_config.adpbias_1;        
+        NVUINT3   memory_index = gbcontrol_config.memory_index_1;
+        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
+        
+        // a response is popped only when no result is held, so the write back 
+        //   never blocks the loop
+        spec::GB::Small::DataRsp small_rsp_reg;
+        if (!is_write_held && small_rsp.PopNB(small_rsp_reg)) {
+          Normalize(x_cache[nvhls::get_slc<6>(return_counter, 0)], small_rsp_reg, out_data);
+          
+          write_req_reg.is_write = 1;
+          write_req_reg.memory_index = memory_index;
+          write_req_reg.vector_index = return_counter;
+          write_req_reg.timestep_index = timestep_index;
+          Fixed2Adpfloat (out_data, write_req_reg.write_data, adpbias_enc);
+          is_write_held = 1;
+        }
+        if (is_write_held && large_req.PushNB(write_req_reg)) {
+          is_write_held = 0;
+          return_counter += 1;
+        }
+        
+        if (issue_counter < gbcontrol_config.num_vector_1) {
+          spec::GB::Small::DataReq small_req_reg;          
+          small_req_reg.is_write = 0;
+          small_req_reg.memory_index = gamma_index;
+          small_req_reg.vector_index = issue_counter;
+          small_req_reg.is_dual = 1;
+          small_req_reg.memory_index_2 = beta_index;
+          small_req_reg.vector_index_2 = issue_counter;
+          if (small_req.PushNB(small_req_reg)) {
+            issue_counter += 1;
+          }
+        }
+        break;
+      }
       case NEXT: {
         break;
       }
@@ -375,8 +505,10 @@ class LayerNorm : public match::Module {
         // Wait for start signal (Axi config)
         if (is_start) {
           gbcontrol_config.ResetCounter();
+          gbcontrol_config.ValidLengthWrite(valid_length.read());
+          gbcontrol_config.SetTimestepBound(gbcontrol_config.memory_index_1);
           ResetMeanVar();
-          next_state = MEAN;
+          next_state = IsSinglePass() ? READ : MEAN;
         }
         else {
           next_state = IDLE;
@@ -389,17 +521,25 @@ class LayerNorm : public match::Module {
       }
       case MEAN2: { // first data read
         bool is_end = 0;
-        gbcontrol_config.UpdateVectorCounter(is_end);
-        if (is_end) {
-          next_state = VAR;
+        if (gbcontrol_config.is_residual && (issue_phase == 0)) {
+          // residual of the same vector
+          issue_phase = 1;
+          next_state = MEAN;
         }
         else {
-          next_state = MEAN;
+          issue_phase = 0;
+          gbcontrol_config.UpdateVectorCounter(is_end);
+          if (is_end) {
+            next_state = VAR;
+          }
+          else {
+            next_state = MEAN;
+          }
         }
         break;
       }
       case VAR: {
-        next_state = NORM;
+        next_state = IsSinglePass() ? OUTPUT : NORM;
         break;        
       }
       case NORM: { // second data read NORM, GAMMA BETA
@@ -407,7 +547,14 @@ class LayerNorm : public match::Module {
         break;
       }
       case NORM2: { 
-        next_state = GAMMA;
+        if (gbcontrol_config.is_residual && (issue_phase == 0)) {
+          issue_phase = 1;
+          next_state = NORM;
+        }
+        else {
+          issue_phase = 0;
+          next_state = GAMMA;
+        }
         break;
       }
       case GAMMA: {
@@ -415,18 +562,10 @@ class LayerNorm : public match::Module {
         break;
       }
       case GAMMA2: {
-        next_state = BETA; 
+        next_state = WRITE; 
         break;
       }
-      case BETA: {
-        next_state = BETA2;
-        break;
-      }
-      case BETA2: {
-        next_state = BETA3;
-        break;
-      }
-      case BETA3: { 
+      case WRITE: { 
         bool is_end = 0;
         gbcontrol_config.UpdateVectorCounter(is_end);
         if (is_end) {
@@ -451,7 +590,25 @@ class LayerNorm : public match::Module {
           done.Push(1);    
         }
         else {
-          next_state = MEAN;
+          next_state = IsSinglePass() ? READ : MEAN;
+        }
+        break;
+      }
+      case READ: {
+        if (return_counter == gbcontrol_config.num_vector_1) {
+          next_state = VAR;
+        }
+        else {
+          next_state = READ;
+        }
+        break;
+      }
+      case OUTPUT: {
+        if (return_counter == gbcontrol_config.num_vector_1) {
+          next_state = NEXT;
+        }
+        else {
+          next_state = OUTPUT;
         }
         break;
       }
@@ -468,7 +625,7 @@ class LayerNorm : public match::Module {
   void LayerNormRun() {
     Reset();
 
-    #pragma hls_pipeline_init_interval 4 
+    #pragma hls_pipeline_init_interval 1 
     while(1) {
       Initialize();
       RunFSM();
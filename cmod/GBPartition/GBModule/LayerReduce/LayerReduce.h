@@ -34,6 +34,8 @@
 
 class LayerReduce : public match::Module {
   static const int kDebugLevel = 4;
+  static const int kMaxPool = 8;
+  static const int kMaxOutstanding = 4;
   SC_HAS_PROCESS(LayerReduce);
  public:
   Connections::In<spec::Axi::SlaveToRVA::Write> rva_in;
@@ -43,7 +45,11 @@ class LayerReduce : public match::Module {
   Connections::Out<bool> done;
  
   Connections::Out<spec::GB::Large::DataReq>      large_req;
-  Connections::In<spec::GB::Large::DataRsp<2>>    large_rsp;  
+  Connections::In<spec::GB::Large::DataRsp<8>>    large_rsp;  
+
+  // Valid timesteps of each large buffer region (GBCore 0x4 local 0x05), written by GBRVA,
+  //   sampled at start
+  sc_in<spec::GB::Large::ValidLengthType> valid_length;
 
   // Constructor
   LayerReduce (sc_module_name nm)
@@ -53,7 +59,8 @@ class LayerReduce : public match::Module {
         start("start"),
         done("done"),
         large_req("large_req"),
-        large_rsp("large_rsp")
+        large_rsp("large_rsp"),
+        valid_length("valid_length")
   {
     SC_THREAD(LayerReduceRun);
     sensitive << clk.pos();
@@ -62,7 +69,7 @@ class LayerReduce : public match::Module {
   
   // A. FSM
   enum FSM {
-    IDLE, PRE, REDUCE, FIN
+    IDLE, REDUCE, FIN
   };
   FSM state;                 
   
@@ -73,9 +80,19 @@ class LayerReduce : public match::Module {
   bool w_axi_rsp; //w_done;
   spec::Axi::SlaveToRVA::Read rva_out_reg;  
   
+  // Streaming state of REDUCE: reads in flight are [return_counter, issue_counter),
+  //   reduced vectors waiting for large_req are [write_counter, return_counter), 
+  //   both bounded by kMaxOutstanding so that every response can be popped at once
+  bool is_issue_end, is_read_turn;
+  NVUINT3 issue_counter, return_counter, write_counter;
+  NVUINT8 write_vector[kMaxOutstanding];
+  NVUINT16 write_timestep[kMaxOutstanding];
+  spec::VectorType write_data[kMaxOutstanding];
+  
  void Reset() {
     state = IDLE;
     is_start = 0;
+    ResetStream();
     gbcontrol_config.Reset();
     ResetPorts();
   }
@@ -89,6 +106,14 @@ class LayerReduce : public match::Module {
     large_rsp.Reset();
   }  
 
+  void ResetStream() {
+    is_issue_end = 0;
+    is_read_turn = 1;
+    issue_counter = 0;
+    return_counter = 0;
+    write_counter = 0;
+  }
+
   void DecodeAxiWrite(const spec::Axi::SlaveToRVA::Write& rva_in_reg){
     NVUINT4     tmp = nvhls::get_slc<4>(rva_in_reg.addr, 20);
     NVUINT16    local_index = nvhls::get_slc<16>(rva_in_reg.addr, 4);
@@ -136,77 +161,110 @@ class LayerReduce : public match::Module {
   }
   
   
+  // Timesteps reduced into one output, num_pool of 2, 4 or 8
+  NVUINT2 GetPoolShift() const {
+    NVUINT2 shift;
+    if (gbcontrol_config.num_pool == 8) {
+      shift = 3;
+    }
+    else if (gbcontrol_config.num_pool == 4) {
+      shift = 2;
+    }
+    else {
+      shift = 1;
+    }
+    return shift;
+  }
+  
+  // Pairwise tree over the first (1 << pool_shift) read vectors 
+  void Reduce(const spec::GB::Large::DataRsp<kMaxPool>& large_rsp_reg, const NVUINT2 pool_shift, 
+              spec::VectorType& write_data) const {
+    NVUINT3   mode = gbcontrol_config.mode;
+    spec::VectorType reduce_vector[kMaxPool];
+    #pragma hls_unroll yes
+    for (int j = 0; j < kMaxPool; j++) {
+      reduce_vector[j] = large_rsp_reg.read_vector[j];
+    }
+    
+    #pragma hls_unroll yes
+    for (int level = 0; level < 3; level++) {
+      #pragma hls_unroll yes
+      for (int j = 0; j < (kMaxPool >> (level+1)); j++) {
+        #pragma hls_unroll yes
+        for (int i = 0; i < spec::kVectorSize; i++) {
+          AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> in_a(reduce_vector[2*j][i]);
+          AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> in_b(reduce_vector[2*j+1][i]);  
+          AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> out_tmp;
+          if (mode == 0) { // max pool
+            adpfloat_max(in_a, in_b, out_tmp);
+          }
+          else if (mode == 1) { // mean pool, mean of means for power of two
+            adpfloat_mean(in_a, in_b, out_tmp);
+          }
+          else { // layer add
+            adpfloat_add(in_a, in_b, out_tmp);
+          }
+          if (level < pool_shift) {
+            reduce_vector[j][i] = out_tmp.to_rawbits();
+          }
+        }
+      }
+    }
+    write_data = reduce_vector[0];
+  }
+  
   void RunFSM(){
     switch (state) {
       case IDLE: {
         
         break;
       }
-      case PRE: {
-        NVUINT3   memory_index = gbcontrol_config.memory_index_1;
-        NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
-        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
-        //NVUINT3   mode = gbcontrol_config.mode;
-
-        spec::GB::Large::DataReq large_req_reg;
-        large_req_reg.is_write = 0;
-        large_req_reg.memory_index = memory_index;
-        large_req_reg.vector_index = vector_index;
-        large_req_reg.timestep_index = timestep_index;
-        //large_req_reg.write_data = 0;
-        large_req.Push(large_req_reg);
-        break;
-      }
-        // it should receive two data from adjecent timestep
-        // large_rsp_reg.read_vector[0], large_rsp_reg.read_vector[1];
       case REDUCE: {
-        NVUINT3   memory_index = gbcontrol_config.memory_index_1;
-        NVUINT8   vector_index = gbcontrol_config.GetVectorIndex();
-        NVUINT16  timestep_index = gbcontrol_config.GetTimestepIndex();
-        NVUINT3   mode = gbcontrol_config.mode;
-        spec::GB::Large::DataReq large_req_reg;
-
-        spec::GB::Large::DataRsp<2> large_rsp_reg;
-        large_rsp_reg = large_rsp.Pop();
+        // One read of num_pool adjacent timesteps (one bank each) per output vector,
+        //   up to kMaxOutstanding reads in flight, responses return in request order.
+        //   large_req carries both reads and writes, it alternates between them when both wait 
+        NVUINT2   pool_shift = GetPoolShift();
+        NVUINT3   num_used = issue_counter - write_counter;
+        bool      is_issue = !is_issue_end && (num_used < kMaxOutstanding);
+        bool      is_write = (write_counter != return_counter);
         
-        spec::VectorType write_data;
-        if (mode == 0) { // max pool
-          #pragma hls_unroll yes
-          for (int i = 0; i < spec::kVectorSize; i++) {
-            AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> in_a(large_rsp_reg.read_vector[0][i]);
-            AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> in_b(large_rsp_reg.read_vector[1][i]);  
-            AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> out_tmp;
-            adpfloat_max(in_a, in_b, out_tmp);
-            write_data[i] = out_tmp.to_rawbits();
+        if (is_write && !(is_read_turn && is_issue)) {
+          NVUINT2 slot = nvhls::get_slc<2>(write_counter, 0);
+          spec::GB::Large::DataReq large_req_reg;
+          large_req_reg.is_write = 1;
+          large_req_reg.memory_index = gbcontrol_config.memory_index_1;
+          large_req_reg.vector_index = write_vector[slot];
+          large_req_reg.timestep_index = write_timestep[slot];
+          large_req_reg.write_data = write_data[slot];
+          if (large_req.PushNB(large_req_reg)) {
+            write_counter += 1;
+            is_read_turn = 1;
           }
         }
-        else if (mode == 1) { // mean pool
-          #pragma hls_unroll yes
-          for (int i = 0; i < spec::kVectorSize; i++) {
-            AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> in_a(large_rsp_reg.read_vector[0][i]);
-            AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> in_b(large_rsp_reg.read_vector[1][i]);  
-            AdpfloatType<spec::kAdpfloatWordWidth,spec::kAdpfloatExpWidth> out_tmp;
-            adpfloat_mean(in_a, in_b, out_tmp);
-            write_data[i] = out_tmp.to_rawbits();            
-          }          
+        else if (is_issue) {
+          spec::GB::Large::DataReq large_req_reg;
+          large_req_reg.is_write = 0;
+          large_req_reg.memory_index = gbcontrol_config.memory_index_1;
+          large_req_reg.vector_index = gbcontrol_config.GetVectorIndex();
+          large_req_reg.timestep_index = gbcontrol_config.GetTimestepIndex();
+          large_req_reg.pool_shift = pool_shift;
+          if (large_req.PushNB(large_req_reg)) {
+            // when write, please divide the timestep index by num_pool
+            NVUINT2 slot = nvhls::get_slc<2>(issue_counter, 0);
+            write_vector[slot] = large_req_reg.vector_index;
+            write_timestep[slot] = (large_req_reg.timestep_index >> pool_shift);
+            issue_counter += 1;
+            is_read_turn = 0;
+            UpdateIssueCounter(pool_shift);
+          }
         }
-        else { // layer add
-          #pragma hls_unroll yes
-          for (int i = 0; i < spec::kVectorSize; i++) {
-            AdpfloatType<spec::kAdpfloatWordWidth, spec::kAdpfloatExpWidth> in_a(large_rsp_reg.read_vector[0][i]);
-            AdpfloatType<spec::kAdpfloatWordWidth, spec::kAdpfloatExpWidth> in_b(large_rsp_reg.read_vector[1][i]);  
-            AdpfloatType<spec::kAdpfloatWordWidth, spec::kAdpfloatExpWidth> out_tmp;
-            adpfloat_add(in_a, in_b, out_tmp);
-            write_data[i] = out_tmp.to_rawbits();  
-          }        
+        
+        spec::GB::Large::DataRsp<kMaxPool> large_rsp_reg;
+        if ((return_counter != issue_counter) && large_rsp.PopNB(large_rsp_reg)) {
+          NVUINT2 slot = nvhls::get_slc<2>(return_counter, 0);
+          Reduce(large_rsp_reg, pool_shift, write_data[slot]);
+          return_counter += 1;
         }
-        // when write, please divide the timestep index by one
-        large_req_reg.is_write = 1;
-        large_req_reg.memory_index = memory_index;
-        large_req_reg.vector_index = vector_index;
-        large_req_reg.timestep_index = (timestep_index >> 1);
-        large_req_reg.write_data = write_data;
-        large_req.Push(large_req_reg);
         break;
       }
       case FIN: {
@@ -218,6 +276,17 @@ class LayerReduce : public match::Module {
     }
   }
   
+  void UpdateIssueCounter(const NVUINT2 pool_shift) {
+    bool is_end_0 = 0, is_end_1 = 0;
+    gbcontrol_config.UpdateVectorCounter(is_end_0);
+    if (is_end_0) { 
+      NVUINT4 step = 1;
+      step = step << pool_shift;
+      gbcontrol_config.UpdateTimestepCounterBy(step, is_end_1);
+      is_issue_end = is_end_1;
+    }
+  }
+  
   void UpdateFSM(){
     FSM next_state;
     switch (state) {
@@ -225,36 +294,24 @@ class LayerReduce : public match::Module {
         // Wait for start signal (Axi config)
         if (is_start) {
           gbcontrol_config.ResetCounter();
-          next_state = PRE;
+          gbcontrol_config.ValidLengthWrite(valid_length.read());
+          gbcontrol_config.SetTimestepBound(gbcontrol_config.memory_index_1);
+          ResetStream();
+          next_state = REDUCE;
         }
         else {
           next_state = IDLE;
         }
         break;
       }
-      case PRE: {
-        next_state = REDUCE;
-        break;
-      }
       case REDUCE: {
-        // Send Data from GB to PE
-        bool is_end_0 = 0, is_end_1 = 0;
-        gbcontrol_config.UpdateVectorCounter(is_end_0);
-        if (is_end_0) { 
-          // update by 2 for layer reduce operation
-          gbcontrol_config.UpdateTimestepCounterByTwo(is_end_1);
-          if (is_end_1) {
-            next_state = FIN; 
-          }
-          else {
-            next_state = PRE;          
-          }         
+        if (is_issue_end && (issue_counter == write_counter)) {
+          next_state = FIN; 
         }
         else {
-          next_state = PRE;
+          next_state = REDUCE;
         }
         break;
-        
       }
       case FIN: {
         is_start = 0;
@@ -279,7 +336,7 @@ class LayerReduce : public match::Module {
   
   void LayerReduceRun(){
     Reset();
-    #pragma hls_pipeline_init_interval 2 
+    #pragma hls_pipeline_init_interval 1 
     while(1) {
       Initialize();
       RunFSM();
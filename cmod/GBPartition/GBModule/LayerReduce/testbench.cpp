@@ -57,12 +57,12 @@ SC_MODULE(Source) {
   Connections::Out<spec::Axi::SlaveToRVA::Write> rva_in;
   
   Connections::Out<bool> start;
-  Connections::Out<spec::GB::Large::DataRsp<2>>    large_rsp;
+  Connections::Out<spec::GB::Large::DataRsp<8>>    large_rsp;
 
   std::vector<spec::Axi::SlaveToRVA::Write> src_vec;
   bool start_src; 
   
-  spec::GB::Large::DataRsp<2> large_rsp_src;  
+  spec::GB::Large::DataRsp<8> large_rsp_src;  
   
   SC_CTOR(Source) {
     SC_THREAD(run);
@@ -157,7 +157,8 @@ SC_MODULE(testbench) {
   Connections::Combinational<bool> done;
  
   Connections::Combinational<spec::GB::Large::DataReq>      large_req;
-  Connections::Combinational<spec::GB::Large::DataRsp<2>>    large_rsp;  
+  Connections::Combinational<spec::GB::Large::DataRsp<8>>    large_rsp;  
+  sc_signal<spec::GB::Large::ValidLengthType> valid_length;   // 0: whole region
 
   NVHLS_DESIGN(LayerReduce) dut;
   Source  source;
@@ -179,6 +180,7 @@ SC_MODULE(testbench) {
     dut.done(done);
     dut.large_req(large_req);
     dut.large_rsp(large_rsp);
+    dut.valid_length(valid_length);
     
     source.clk(clk);
     source.rst(rst);
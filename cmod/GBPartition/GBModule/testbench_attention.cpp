@@ -301,11 +301,16 @@ SC_MODULE(Dest) {
   } //PopDataOut
 
   void PopDone() {
+   // cycles from reset to each done (attention, then decoder-mode GBControl) 
+   unsigned cycle = 0, last_done = 0;
    wait();
    while (1) {
      if (done.PopNB(done_dest)) {
         cout << sc_time_stamp() << " Done signal issued!!!" << " \t " << done_dest << endl;
+        cout << dec << "Cycles: " << cycle << " total, " << cycle - last_done << " since last done" << endl;
+        last_done = cycle;
      }
+     cycle++;
      wait(); 
    } // while
   } //PopDone
@@ -333,6 +338,9 @@ SC_MODULE(testbench) {
   Connections::Combinational<spec::StreamType> data_out;     
   Connections::Combinational<bool> pe_start;  
   Connections::Combinational<bool> pe_done;  
+  Connections::Combinational<bool> pe_start_done_1;  // PE group 1 start looped back as its done
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_done_status;
   Connections::Combinational<bool> done;  
 
   NVHLS_DESIGN(GBModule) dut;
@@ -356,6 +364,10 @@ SC_MODULE(testbench) {
     dut.data_in(data_in);
     dut.done(done);
     dut.pe_done(pe_done);
+    dut.pe_start_1(pe_start_done_1);
+    dut.pe_done_1(pe_start_done_1);
+    dut.pe_group(pe_group);
+    dut.pe_done_status(pe_done_status);
     dut.pe_start(pe_start);
 
     source.clk(clk);
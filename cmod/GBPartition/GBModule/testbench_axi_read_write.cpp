@@ -128,6 +128,9 @@ SC_MODULE(testbench) {
   Connections::Combinational<spec::StreamType> data_in;     
   Connections::Combinational<bool> pe_start;  
   Connections::Combinational<bool> pe_done;
+  Connections::Combinational<bool> pe_start_done_1;  // PE group 1 start looped back as its done
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_done_status;
   Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
   Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
   Connections::Combinational<spec::StreamType> data_out; 
@@ -150,6 +153,10 @@ SC_MODULE(testbench) {
      dut.data_in(data_in);
      dut.pe_start(pe_start);
      dut.pe_done(pe_done);
+     dut.pe_start_1(pe_start_done_1);
+     dut.pe_done_1(pe_start_done_1);
+     dut.pe_group(pe_group);
+     dut.pe_done_status(pe_done_status);
      dut.rva_in(rva_in);
      dut.rva_out(rva_out);
      dut.data_out(data_out);
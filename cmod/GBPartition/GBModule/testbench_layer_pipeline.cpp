@@ -0,0 +1,381 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "GBModule.h"
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+#include <nvhls_int.h>
+#include <nvhls_types.h>
+#include <nvhls_vector.h>
+
+#include "SM6Spec.h"
+#include "AxiSpec.h"
+#include "AdpfloatSpec.h"
+#include "AdpfloatUtils.h"
+
+#include "helper.h"
+
+#define NVHLS_VERIFY_BLOCKS (GBModule)
+#include <nvhls_verify.h>
+
+
+#ifdef COV_ENABLE
+   #pragma CTC SKIP
+#endif
+
+// Layer pipelining over both PE groups (GBStream):
+//   GBControl (group 0) runs layer 0 from region 0 to region 1, GBControl1 (group 1, is_follow)
+//   runs layer 1 from region 1 to region 2, both started before any of them is done.
+//   Each PE group adds 1 to every byte of its inputs, region 2 must hold x + 2.
+//   Dest checks that group 1 streams timestep t only after group 0 is done with t,
+//   that the outputs of each group stay in order, and that the two layers overlap
+
+// Large buffer regions: 0 x, 1 layer 0 output, 2 layer 1 output
+const unsigned kNumVector    = 2;
+const unsigned kNumTimestep  = 6;
+const unsigned kPoison       = 0x55;  // initial regions 1 and 2, read early by layer 1 if out of order
+const unsigned kDoneDelay    = 4;     // cycles between the last PE output and its done
+
+SC_MODULE(Source) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::Out<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::In<spec::Axi::SlaveToRVA::Read>   rva_out;
+  Connections::In<bool>                          done;
+
+  std::vector<spec::VectorType> x;    // timestep*kNumVector + vector
+  bool is_finished;
+
+  SC_CTOR(Source) {
+    is_finished = 0;
+    SC_THREAD(run);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void AxiWrite(const unsigned addr, const NVUINTW(128) data) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 1;
+    rva_in_src.addr = addr;
+    rva_in_src.data = data;
+    rva_in.Push(rva_in_src);
+    wait();
+  }
+
+  NVUINTW(128) AxiRead(const unsigned addr) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 0;
+    rva_in_src.addr = addr;
+    rva_in_src.data = 0;
+    rva_in.Push(rva_in_src);
+    spec::Axi::SlaveToRVA::Read rva_out_dest = rva_out.Pop();
+    wait();
+    return rva_out_dest.data;
+  }
+
+  // Large buffer entry of timestep t, vector v in the region at base (t < 16)
+  unsigned LargeAddr(const unsigned base, const unsigned t, const unsigned v) {
+    return 0x500000 + (base + 16*v + t)*16;
+  }
+
+  unsigned RegionBase(const unsigned region) {
+    return region*16*kNumVector;
+  }
+
+  // GBControl config block at base, layer from memory_index_1 to memory_index_2
+  void Config(const unsigned base, const unsigned memory_index_1, const unsigned memory_index_2,
+              const bool is_follow) {
+    GBControlConfig config;
+    config.Reset();
+    config.is_valid       = 1;
+    config.mode           = 0;
+    config.is_follow      = is_follow;
+    config.memory_index_1 = memory_index_1;
+    config.memory_index_2 = memory_index_2;
+    config.num_vector_1   = kNumVector;
+    config.num_timestep_1 = kNumTimestep;
+    NVUINTW(128) data;
+    config.ConfigRead(0x01, data);
+    AxiWrite(base + 0x10, data);
+    config.ConfigRead(0x02, data);
+    AxiWrite(base + 0x20, data);
+  }
+
+  void Load() {
+    NVUINTW(128) large_config = 0;
+    for (unsigned r = 0; r < 3; r++) {
+      large_config.set_slc<8>(32*r, NVUINT8(kNumVector));
+      large_config.set_slc<16>(32*r+16, NVUINT16(RegionBase(r)));
+    }
+    AxiWrite(0x400010, large_config);
+
+    spec::VectorType poison;
+    for (unsigned k = 0; k < 16; k++) {
+      poison[k] = kPoison;
+    }
+    x.clear();
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < kNumVector; v++) {
+        spec::VectorType vec;
+        for (unsigned k = 0; k < 16; k++) {
+          vec[k] = nvhls::get_rand<8>();
+        }
+        x.push_back(vec);
+        AxiWrite(LargeAddr(RegionBase(0), t, v), vec.to_rawbits());
+        AxiWrite(LargeAddr(RegionBase(1), t, v), poison.to_rawbits());
+        AxiWrite(LargeAddr(RegionBase(2), t, v), poison.to_rawbits());
+      }
+    }
+
+    Config(0x700000, 0, 1, 0);
+    Config(0xC00000, 1, 2, 1);
+  }
+
+  // region holds x + offset in every byte
+  void Check(const unsigned region, const unsigned offset) {
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < kNumVector; v++) {
+        spec::VectorType out_vec(AxiRead(LargeAddr(RegionBase(region), t, v)));
+        for (unsigned k = 0; k < 16; k++) {
+          assert(out_vec[k] == spec::ScalarType(x[t*kNumVector + v][k] + offset));
+        }
+      }
+    }
+  }
+
+  void run() {
+    wait();
+
+    Load();
+    // layer 1 first, it waits for layer 0 (is_follow)
+    AxiWrite(0x6 << 4, 0);
+    AxiWrite(0x1 << 4, 0);
+    unsigned cycle = 1;
+    for (unsigned i = 0; i < 2; i++) {
+      bool done_reg;
+      while (!done.PopNB(done_reg)) {
+        cycle++;
+        wait();
+      }
+    }
+    cout << "Two layers, " << kNumTimestep << " timesteps: " << cycle << " cycles" << endl;
+    Check(1, 1);
+    Check(2, 2);
+
+    is_finished = 1;
+    cout << sc_time_stamp() << " layer pipeline checks passed" << endl;
+  } // run()
+
+}; //SC MODULE Source
+
+// Both PE groups, each adds 1 to every input byte and returns it as output of the same vector
+SC_MODULE(Dest) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::In<spec::StreamType>  data_out;
+  Connections::In<bool>              pe_start;
+  Connections::In<bool>              pe_start_1;
+  Connections::Out<spec::StreamType> data_in;
+  Connections::Out<bool>             pe_done;
+  Connections::Out<bool>             pe_done_1;
+
+  bool is_overlap;   // group 1 streamed while group 0 was still running
+
+  SC_CTOR(Dest) {
+    is_overlap = 0;
+    SC_THREAD(PERun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void PERun() {
+    spec::VectorType in_regs[spec::kNumPEGroups][kNumVector];
+    unsigned in_counter[spec::kNumPEGroups], out_counter[spec::kNumPEGroups];
+    unsigned delay_counter[spec::kNumPEGroups], num_done[spec::kNumPEGroups];
+    bool     is_run[spec::kNumPEGroups];
+    for (unsigned g = 0; g < spec::kNumPEGroups; g++) {
+      in_counter[g] = 0;
+      out_counter[g] = 0;
+      delay_counter[g] = 0;
+      num_done[g] = 0;
+      is_run[g] = 0;
+    }
+    wait();
+    while (1) {
+      spec::StreamType data_out_reg;
+      if (data_out.PopNB(data_out_reg)) {
+        unsigned g = data_out_reg.group;
+        // no prefetch, timestep t+1 is streamed after the done of t, in vector order
+        assert(!is_run[g]);
+        assert(data_out_reg.logical_addr == in_counter[g]);
+        if ((g == 1) && (in_counter[g] == 0)) {
+          // layer 1 timestep num_done[1] needs the layer 0 output of that timestep
+          assert(num_done[0] > num_done[1]);
+          if (num_done[0] < kNumTimestep) is_overlap = 1;
+        }
+        in_regs[g][in_counter[g]] = data_out_reg.data;
+        in_counter[g]++;
+      }
+
+      // start after the whole stream of the group
+      bool start_reg;
+      if (pe_start.PopNB(start_reg)) {
+        assert(!is_run[0] && (in_counter[0] == kNumVector));
+        is_run[0] = 1;
+      }
+      if (pe_start_1.PopNB(start_reg)) {
+        assert(!is_run[1] && (in_counter[1] == kNumVector));
+        is_run[1] = 1;
+      }
+
+      // one output per cycle on the shared data_in, group 0 first
+      bool is_pushed = 0;
+      for (unsigned g = 0; g < spec::kNumPEGroups; g++) {
+        if (is_run[g] && !is_pushed && (out_counter[g] < kNumVector)) {
+          spec::StreamType data_in_reg;
+          for (unsigned k = 0; k < 16; k++) {
+            data_in_reg.data[k] = in_regs[g][out_counter[g]][k] + 1;
+          }
+          data_in_reg.index = 0;
+          data_in_reg.logical_addr = out_counter[g];
+          data_in_reg.group = g;
+          data_in_reg.pe_src = 0;
+          is_pushed = 1;
+          if (data_in.PushNB(data_in_reg)) {
+            out_counter[g]++;
+          }
+        }
+      }
+
+      // done some cycles after the last output (no DataBus here)
+      for (unsigned g = 0; g < spec::kNumPEGroups; g++) {
+        if (is_run[g] && (out_counter[g] == kNumVector) && (++delay_counter[g] > kDoneDelay)) {
+          if (g == 0) pe_done.Push(1);
+          else        pe_done_1.Push(1);
+          is_run[g] = 0;
+          in_counter[g] = 0;
+          out_counter[g] = 0;
+          delay_counter[g] = 0;
+          num_done[g]++;
+        }
+      }
+      wait();
+    } // while
+  } //PERun
+
+}; //SC MODULE Dest
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
+  Connections::Combinational<spec::StreamType> data_in;
+  Connections::Combinational<spec::StreamType> data_out;
+  Connections::Combinational<bool> pe_start;
+  Connections::Combinational<bool> pe_done;
+  Connections::Combinational<bool> pe_start_1;
+  Connections::Combinational<bool> pe_done_1;
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_done_status;
+  Connections::Combinational<bool> done;
+
+  NVHLS_DESIGN(GBModule) dut;
+  Source  source;
+  Dest    dest;
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    dut("dut"),
+    source("source"),
+    dest("dest")
+  {
+
+    dut.clk(clk);
+    dut.rst(rst);
+    dut.rva_in(rva_in);
+    dut.rva_out(rva_out);
+    dut.data_out(data_out);
+    dut.data_in(data_in);
+    dut.done(done);
+    dut.pe_done(pe_done);
+    dut.pe_start_1(pe_start_1);
+    dut.pe_done_1(pe_done_1);
+    dut.pe_group(pe_group);
+    dut.pe_done_status(pe_done_status);
+    dut.pe_start(pe_start);
+
+    source.clk(clk);
+    source.rst(rst);
+    source.rva_in(rva_in);
+    source.rva_out(rva_out);
+    source.done(done);
+
+    dest.clk(clk);
+    dest.rst(rst);
+    dest.data_out(data_out);
+    dest.pe_start(pe_start);
+    dest.pe_start_1(pe_start_1);
+    dest.data_in(data_in);
+    dest.pe_done(pe_done);
+    dest.pe_done_1(pe_done_1);
+
+    SC_THREAD(run);
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(20000, SC_NS );
+    assert(source.is_finished);
+    assert(dest.is_overlap);
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+}; //SC Module testbench
+
+int sc_main(int argc, char *argv[]) {
+  nvhls::set_random_seed();
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
@@ -0,0 +1,379 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "GBModule.h"
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+#include <nvhls_int.h>
+#include <nvhls_types.h>
+#include <nvhls_vector.h>
+
+#include "SM6Spec.h"
+#include "AxiSpec.h"
+#include "AdpfloatSpec.h"
+#include "AdpfloatUtils.h"
+
+#include "helper.h"
+
+#define NVHLS_VERIFY_BLOCKS (GBModule)
+#include <nvhls_verify.h>
+
+
+#ifdef COV_ENABLE
+   #pragma CTC SKIP
+#endif
+
+// LayerNorm with is_residual on random data (no npy files), the output (written back
+//   over memory_index_1) is checked against a float LayerNorm of x + residual:
+//   1. 16 vectors, single pass (READ/OUTPUT)
+//   2. 80 vectors, two-pass path (MEAN/NORM), num_vector_1 > kNumCacheVectors
+//   3. 80 vectors without is_residual, the residual region must not change the output
+
+// Large buffer regions: 0 holds x (and the output), 1 the residual
+// Small buffer regions: 5 gamma, 6 beta (LayerNorm gamma_index, beta_index)
+const unsigned kGammaBase    = 0x100;
+const unsigned kBetaBase     = 0x200;
+const unsigned kNumTimestep  = 2;
+
+// adpbias_1 x and output, adpbias_2 residual, adpbias_3 beta, adpbias_4 gamma
+const int kAdpbiasX = 3, kAdpbiasRes = 2, kAdpbiasBeta = 1, kAdpbiasGamma = 1;
+
+spec::ScalarType ToAdpfloat(const double value, const int adpbias) {
+  AdpfloatType<8,3> tmp;
+  tmp.set_value(value, adpbias);
+  return tmp.to_rawbits();
+}
+
+double FromAdpfloat(const spec::ScalarType rawbits, const int adpbias) {
+  AdpfloatType<8,3> tmp(rawbits);
+  return tmp.to_float(adpbias);
+}
+
+SC_MODULE(Source) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::Out<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::In<spec::Axi::SlaveToRVA::Read>   rva_out;
+  Connections::In<bool>                          done;
+
+  // quantized values in the buffers, timestep x 16*num_vector
+  std::vector<std::vector<double>>  x, res;
+  std::vector<double>               gamma, beta;
+  bool is_finished;
+
+  SC_CTOR(Source) {
+    is_finished = 0;
+    SC_THREAD(run);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void AxiWrite(const unsigned addr, const NVUINTW(128) data) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 1;
+    rva_in_src.addr = addr;
+    rva_in_src.data = data;
+    rva_in.Push(rva_in_src);
+    wait();
+  }
+
+  NVUINTW(128) AxiRead(const unsigned addr) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 0;
+    rva_in_src.addr = addr;
+    rva_in_src.data = 0;
+    rva_in.Push(rva_in_src);
+    spec::Axi::SlaveToRVA::Read rva_out_dest = rva_out.Pop();
+    wait();
+    return rva_out_dest.data;
+  }
+
+  // GB start (0x0 local_index), then wait for done
+  unsigned Run(const unsigned local_index) {
+    AxiWrite(local_index << 4, 0);
+    unsigned cycle = 1;
+    bool done_reg;
+    while (!done.PopNB(done_reg)) {
+      cycle++;
+      wait();
+    }
+    return cycle;
+  }
+
+  // Random data in [-range, range) quantized with adpbias
+  std::vector<std::vector<double>> RandomData(const unsigned num_vector, const double range,
+                                              const int adpbias) {
+    std::vector<std::vector<double>> data(kNumTimestep, std::vector<double>(16*num_vector));
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned k = 0; k < 16*num_vector; k++) {
+        double value = range*(2.0*rand()/RAND_MAX - 1.0);
+        data[t][k] = FromAdpfloat(ToAdpfloat(value, adpbias), adpbias);
+      }
+    }
+    return data;
+  }
+
+  // Large buffer entry of timestep t, vector v in the region at base (t < 16)
+  unsigned LargeAddr(const unsigned base, const unsigned t, const unsigned v) {
+    return 0x500000 + (base + 16*v + t)*16;
+  }
+
+  void WriteLarge(const std::vector<std::vector<double>>& data, const unsigned num_vector,
+                  const unsigned base, const int adpbias) {
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < num_vector; v++) {
+        spec::VectorType act_vec;
+        for (unsigned k = 0; k < 16; k++) {
+          act_vec[k] = ToAdpfloat(data[t][16*v+k], adpbias);
+        }
+        AxiWrite(LargeAddr(base, t, v), act_vec.to_rawbits());
+      }
+    }
+  }
+
+  void WriteSmall(std::vector<double>& data, const unsigned num_vector, const unsigned base,
+                  const double lo, const double hi, const int adpbias) {
+    data.assign(16*num_vector, 0);
+    for (unsigned v = 0; v < num_vector; v++) {
+      spec::VectorType vec;
+      for (unsigned k = 0; k < 16; k++) {
+        double value = lo + (hi - lo)*rand()/RAND_MAX;
+        vec[k] = ToAdpfloat(value, adpbias);
+        data[16*v+k] = FromAdpfloat(vec[k], adpbias);
+      }
+      AxiWrite(0x600000 + (base + v)*16, vec.to_rawbits());
+    }
+  }
+
+  // Regions 0 and 1 of num_vector vectors, gamma and beta, then LayerNorm config
+  void Load(const unsigned num_vector, const bool is_residual) {
+    NVUINTW(128) large_config = 0, small_config = 0;
+    large_config.set_slc<8>(0, NVUINT8(num_vector));
+    large_config.set_slc<8>(32, NVUINT8(num_vector));
+    large_config.set_slc<16>(48, NVUINT16(16*num_vector));
+    AxiWrite(0x400010, large_config);
+    small_config.set_slc<16>(16*5, NVUINT16(kGammaBase));
+    small_config.set_slc<16>(16*6, NVUINT16(kBetaBase));
+    AxiWrite(0x400020, small_config);
+
+    x   = RandomData(num_vector, 0.5, kAdpbiasX);
+    res = RandomData(num_vector, 0.5, kAdpbiasRes);
+    WriteLarge(x, num_vector, 0, kAdpbiasX);
+    WriteLarge(res, num_vector, 16*num_vector, kAdpbiasRes);
+    WriteSmall(gamma, num_vector, kGammaBase, 0.25, 0.45, kAdpbiasGamma);
+    WriteSmall(beta, num_vector, kBetaBase, -0.2, 0.2, kAdpbiasBeta);
+
+    GBControlConfig config;
+    config.Reset();
+    config.is_valid       = 1;
+    config.is_residual    = is_residual;
+    config.memory_index_1 = 0;
+    config.memory_index_2 = 1;
+    config.num_vector_1   = num_vector;
+    config.num_timestep_1 = kNumTimestep;
+    config.adpbias_1      = kAdpbiasX;
+    config.adpbias_2      = kAdpbiasRes;
+    config.adpbias_3      = kAdpbiasBeta;
+    config.adpbias_4      = kAdpbiasGamma;
+    NVUINTW(128) data;
+    config.ConfigRead(0x01, data);
+    AxiWrite(0x900010, data);
+    config.ConfigRead(0x02, data);
+    AxiWrite(0x900020, data);
+  }
+
+  // Output in region 0 against the float LayerNorm of x (+ residual)
+  void Check(const unsigned num_vector, const bool is_residual) {
+    double err_sum = 0, err_max = 0;
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      std::vector<double> in(16*num_vector);
+      double mean = 0, var = 0;
+      for (unsigned k = 0; k < 16*num_vector; k++) {
+        in[k] = x[t][k] + (is_residual ? res[t][k] : 0);
+        mean += in[k];
+      }
+      mean /= 16*num_vector;
+      for (unsigned k = 0; k < 16*num_vector; k++) {
+        var += (in[k] - mean)*(in[k] - mean);
+      }
+      var /= 16*num_vector;
+      for (unsigned v = 0; v < num_vector; v++) {
+        spec::VectorType out_vec(AxiRead(LargeAddr(0, t, v)));
+        for (unsigned k = 0; k < 16; k++) {
+          unsigned i = 16*v + k;
+          double ref = (in[i] - mean)/sqrt(var)*gamma[i] + beta[i];
+          double err = fabs(FromAdpfloat(out_vec[k], kAdpbiasX) - ref);
+          err_sum += err;
+          err_max = (err > err_max) ? err : err_max;
+        }
+      }
+    }
+    double mae = err_sum / (kNumTimestep*16*num_vector);
+    cout << "LayerNorm num_vector " << num_vector << " is_residual " << is_residual
+         << " mean abs error " << mae << " max abs error " << err_max << endl;
+    assert(mae < 0.05);
+    assert(err_max < 0.25);
+  }
+
+  void run() {
+    wait();
+    srand(15);
+
+    // 1. single pass
+    Load(16, 1);
+    cout << "LayerNorm residual, 16 vectors: " << Run(0x3) << " cycles" << endl;
+    Check(16, 1);
+
+    // 2. two-pass path
+    Load(80, 1);
+    cout << "LayerNorm residual, 80 vectors: " << Run(0x3) << " cycles" << endl;
+    Check(80, 1);
+
+    // 3. two-pass path, residual region ignored
+    Load(80, 0);
+    cout << "LayerNorm, 80 vectors: " << Run(0x3) << " cycles" << endl;
+    Check(80, 0);
+
+    is_finished = 1;
+    cout << sc_time_stamp() << " LayerNorm residual checks passed" << endl;
+  } // run()
+
+}; //SC MODULE Source
+
+// PE side of GBModule, unused by LayerNorm
+SC_MODULE(Dest) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::In<spec::StreamType>  data_out;
+  Connections::In<bool>              pe_start;
+  Connections::Out<spec::StreamType> data_in;
+  Connections::Out<bool>             pe_done;
+
+  SC_CTOR(Dest) {
+    SC_THREAD(PERun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void PERun() {
+    wait();
+    while (1) {
+      spec::StreamType data_out_dest;
+      bool pe_start_dest;
+      data_out.PopNB(data_out_dest);
+      pe_start.PopNB(pe_start_dest);
+      wait();
+    } // while
+  } //PERun
+
+}; //SC MODULE Dest
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
+  Connections::Combinational<spec::StreamType> data_in;
+  Connections::Combinational<spec::StreamType> data_out;
+  Connections::Combinational<bool> pe_start;
+  Connections::Combinational<bool> pe_done;
+  Connections::Combinational<bool> pe_start_done_1;  // PE group 1 start looped back as its done
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_done_status;
+  Connections::Combinational<bool> done;
+
+  NVHLS_DESIGN(GBModule) dut;
+  Source  source;
+  Dest    dest;
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    dut("dut"),
+    source("source"),
+    dest("dest")
+  {
+
+    dut.clk(clk);
+    dut.rst(rst);
+    dut.rva_in(rva_in);
+    dut.rva_out(rva_out);
+    dut.data_out(data_out);
+    dut.data_in(data_in);
+    dut.done(done);
+    dut.pe_done(pe_done);
+    dut.pe_start_1(pe_start_done_1);
+    dut.pe_done_1(pe_start_done_1);
+    dut.pe_group(pe_group);
+    dut.pe_done_status(pe_done_status);
+    dut.pe_start(pe_start);
+
+    source.clk(clk);
+    source.rst(rst);
+    source.rva_in(rva_in);
+    source.rva_out(rva_out);
+    source.done(done);
+
+    dest.clk(clk);
+    dest.rst(rst);
+    dest.data_out(data_out);
+    dest.pe_start(pe_start);
+    dest.data_in(data_in);
+    dest.pe_done(pe_done);
+
+    SC_THREAD(run);
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(100000, SC_NS );
+    assert(source.is_finished);
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+}; //SC Module testbench
+
+int sc_main(int argc, char *argv[]) {
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
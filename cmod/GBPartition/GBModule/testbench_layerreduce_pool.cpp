@@ -0,0 +1,317 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "GBModule.h"
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+#include <nvhls_int.h>
+#include <nvhls_types.h>
+#include <nvhls_vector.h>
+
+#include "SM6Spec.h"
+#include "AxiSpec.h"
+#include "AdpfloatSpec.h"
+#include "AdpfloatUtils.h"
+
+#include "helper.h"
+
+#define NVHLS_VERIFY_BLOCKS (GBModule)
+#include <nvhls_verify.h>
+
+
+#ifdef COV_ENABLE
+   #pragma CTC SKIP
+#endif
+
+// LayerReduce on random data (no npy files), each run reduces 32 timesteps x 4 vectors 
+//   of large buffer region 0 in place and is checked bit-exact against the same 
+//   adpfloat pairwise tree: max and mean pool with num_pool 2, 4 and 8, layer add with 8
+
+const unsigned kNumVector    = 4;
+const unsigned kNumTimestep  = 32;
+const int      kAdpbias      = 2;
+
+SC_MODULE(Source) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::Out<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::In<spec::Axi::SlaveToRVA::Read>   rva_out;
+  Connections::In<bool>                          done;
+
+  // timestep x vector
+  std::vector<std::vector<spec::VectorType>> act;
+  bool is_finished;
+
+  SC_CTOR(Source) {
+    is_finished = 0;
+    SC_THREAD(run);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void AxiWrite(const unsigned addr, const NVUINTW(128) data) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 1;
+    rva_in_src.addr = addr;
+    rva_in_src.data = data;
+    rva_in.Push(rva_in_src);
+    wait();
+  }
+
+  NVUINTW(128) AxiRead(const unsigned addr) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 0;
+    rva_in_src.addr = addr;
+    rva_in_src.data = 0;
+    rva_in.Push(rva_in_src);
+    spec::Axi::SlaveToRVA::Read rva_out_dest = rva_out.Pop();
+    wait();
+    return rva_out_dest.data;
+  }
+
+  // GB start (0x0 local_index), then wait for done
+  unsigned Run(const unsigned local_index) {
+    AxiWrite(local_index << 4, 0);
+    unsigned cycle = 1;
+    bool done_reg;
+    while (!done.PopNB(done_reg)) {
+      cycle++;
+      wait();
+    }
+    return cycle;
+  }
+
+  // Large buffer entry of timestep t, vector v in region 0
+  unsigned LargeAddr(const unsigned t, const unsigned v) {
+    return 0x500000 + (t%16 + ((t/16)*kNumVector + v)*16)*16;
+  }
+
+  void Load() {
+    act.assign(kNumTimestep, std::vector<spec::VectorType>(kNumVector));
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < kNumVector; v++) {
+        for (unsigned k = 0; k < 16; k++) {
+          AdpfloatType<8,3> tmp;
+          tmp.set_value(4.0*rand()/RAND_MAX - 2.0, kAdpbias);
+          act[t][v][k] = tmp.to_rawbits();
+        }
+        AxiWrite(LargeAddr(t, v), act[t][v].to_rawbits());
+      }
+    }
+  }
+
+  // Pairwise tree over num_pool timesteps from t, as LayerReduce::Reduce
+  spec::ScalarType Reduce(const unsigned mode, const unsigned num_pool, const unsigned t, 
+                          const unsigned v, const unsigned k) const {
+    std::vector<AdpfloatType<8,3>> tree;
+    for (unsigned j = 0; j < num_pool; j++) {
+      tree.push_back(AdpfloatType<8,3>(act[t+j][v][k]));
+    }
+    while (tree.size() > 1) {
+      std::vector<AdpfloatType<8,3>> next;
+      for (unsigned j = 0; j < tree.size(); j += 2) {
+        AdpfloatType<8,3> out_tmp;
+        if (mode == 0) {
+          adpfloat_max(tree[j], tree[j+1], out_tmp);
+        }
+        else if (mode == 1) {
+          adpfloat_mean(tree[j], tree[j+1], out_tmp);
+        }
+        else {
+          adpfloat_add(tree[j], tree[j+1], out_tmp);
+        }
+        next.push_back(out_tmp);
+      }
+      tree = next;
+    }
+    return tree[0].to_rawbits();
+  }
+
+  void RunPool(const unsigned mode, const unsigned num_pool) {
+    Load();
+    GBControlConfig config;
+    config.Reset();
+    config.is_valid       = 1;
+    config.mode           = mode;
+    config.num_pool       = num_pool;
+    config.memory_index_1 = 0;
+    config.num_vector_1   = kNumVector;
+    config.num_timestep_1 = kNumTimestep;
+    config.adpbias_1      = kAdpbias;
+    NVUINTW(128) config_data;
+    config.ConfigRead(0x01, config_data);
+    AxiWrite(0x800010, config_data);
+    config.ConfigRead(0x02, config_data);
+    AxiWrite(0x800020, config_data);
+
+    cout << "LayerReduce mode " << mode << " num_pool " << num_pool << ": " << Run(0x2) << " cycles" << endl;
+
+    for (unsigned t = 0; t < kNumTimestep/num_pool; t++) {
+      for (unsigned v = 0; v < kNumVector; v++) {
+        spec::VectorType out_vec(AxiRead(LargeAddr(t, v)));
+        for (unsigned k = 0; k < 16; k++) {
+          assert(out_vec[k] == Reduce(mode, num_pool, t*num_pool, v, k));
+        }
+      }
+    }
+  }
+
+  void run() {
+    wait();
+    srand(16);
+    // large buffer region 0 at base 0
+    NVUINTW(128) large_config = 0;
+    large_config.set_slc<8>(0, NVUINT8(kNumVector));
+    AxiWrite(0x400010, large_config);
+
+    RunPool(0, 2);
+    RunPool(0, 4);
+    RunPool(0, 8);
+    RunPool(1, 2);
+    RunPool(1, 4);
+    RunPool(1, 8);
+    RunPool(2, 8);
+
+    is_finished = 1;
+    cout << sc_time_stamp() << " LayerReduce checks passed" << endl;
+  } // run()
+
+}; //SC MODULE Source
+
+// PE side of GBModule, unused by LayerReduce
+SC_MODULE(Dest) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::In<spec::StreamType>  data_out;
+  Connections::In<bool>              pe_start;
+  Connections::Out<spec::StreamType> data_in;
+  Connections::Out<bool>             pe_done;
+
+  SC_CTOR(Dest) {
+    SC_THREAD(PERun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void PERun() {
+    wait();
+    while (1) {
+      spec::StreamType data_out_dest;
+      bool pe_start_dest;
+      data_out.PopNB(data_out_dest);
+      pe_start.PopNB(pe_start_dest);
+      wait();
+    } // while
+  } //PERun
+
+}; //SC MODULE Dest
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
+  Connections::Combinational<spec::StreamType> data_in;
+  Connections::Combinational<spec::StreamType> data_out;
+  Connections::Combinational<bool> pe_start;
+  Connections::Combinational<bool> pe_done;
+  Connections::Combinational<bool> pe_start_done_1;  // PE group 1 start looped back as its done
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_done_status;
+  Connections::Combinational<bool> done;
+
+  NVHLS_DESIGN(GBModule) dut;
+  Source  source;
+  Dest    dest;
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    dut("dut"),
+    source("source"),
+    dest("dest")
+  {
+
+    dut.clk(clk);
+    dut.rst(rst);
+    dut.rva_in(rva_in);
+    dut.rva_out(rva_out);
+    dut.data_out(data_out);
+    dut.data_in(data_in);
+    dut.done(done);
+    dut.pe_done(pe_done);
+    dut.pe_start_1(pe_start_done_1);
+    dut.pe_done_1(pe_start_done_1);
+    dut.pe_group(pe_group);
+    dut.pe_done_status(pe_done_status);
+    dut.pe_start(pe_start);
+
+    source.clk(clk);
+    source.rst(rst);
+    source.rva_in(rva_in);
+    source.rva_out(rva_out);
+    source.done(done);
+
+    dest.clk(clk);
+    dest.rst(rst);
+    dest.data_out(data_out);
+    dest.pe_start(pe_start);
+    dest.data_in(data_in);
+    dest.pe_done(pe_done);
+
+    SC_THREAD(run);
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(100000, SC_NS );
+    assert(source.is_finished);
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+}; //SC Module testbench
+
+int sc_main(int argc, char *argv[]) {
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
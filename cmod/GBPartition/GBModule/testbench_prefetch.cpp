@@ -0,0 +1,375 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "GBModule.h"
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+#include <nvhls_int.h>
+#include <nvhls_types.h>
+#include <nvhls_vector.h>
+
+#include "SM6Spec.h"
+#include "AxiSpec.h"
+#include "AdpfloatSpec.h"
+#include "AdpfloatUtils.h"
+
+#include "helper.h"
+
+#define NVHLS_VERIFY_BLOCKS (GBModule)
+#include <nvhls_verify.h>
+
+
+#ifdef COV_ENABLE
+   #pragma CTC SKIP
+#endif
+
+// x(t+1) prefetch (GBControlConfig.is_prefetch) to a PE without PEConfig.is_input_dbuf:
+//   the PE only takes inputs while idle, so the prefetched x(t+1) waits in GBControl
+//   until the PE is done with t, GBControl keeps taking the PE outputs meanwhile.
+//   Run once without and once with is_eager, the PE adds 1 to every input byte,
+//   region 1 must hold x + 1 after each run
+
+// Large buffer regions: 0 x, 1 output
+const unsigned kNumVector    = 8;     // more than the stream path between GBControl and PE holds
+const unsigned kNumTimestep  = 4;
+const unsigned kRunCycles    = 40;    // PE compute cycles before the first output
+const unsigned kPoison       = 0x55;
+
+SC_MODULE(Source) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::Out<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::In<spec::Axi::SlaveToRVA::Read>   rva_out;
+  Connections::In<bool>                          done;
+
+  std::vector<spec::VectorType> x;    // timestep*kNumVector + vector
+  bool is_finished;
+
+  SC_CTOR(Source) {
+    is_finished = 0;
+    SC_THREAD(run);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void AxiWrite(const unsigned addr, const NVUINTW(128) data) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 1;
+    rva_in_src.addr = addr;
+    rva_in_src.data = data;
+    rva_in.Push(rva_in_src);
+    wait();
+  }
+
+  NVUINTW(128) AxiRead(const unsigned addr) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 0;
+    rva_in_src.addr = addr;
+    rva_in_src.data = 0;
+    rva_in.Push(rva_in_src);
+    spec::Axi::SlaveToRVA::Read rva_out_dest = rva_out.Pop();
+    wait();
+    return rva_out_dest.data;
+  }
+
+  // Large buffer entry of timestep t, vector v in the region at base (t < 16)
+  unsigned LargeAddr(const unsigned base, const unsigned t, const unsigned v) {
+    return 0x500000 + (base + 16*v + t)*16;
+  }
+
+  unsigned RegionBase(const unsigned region) {
+    return region*16*kNumVector;
+  }
+
+  void Config(const bool is_eager) {
+    GBControlConfig config;
+    config.Reset();
+    config.is_valid       = 1;
+    config.mode           = 0;
+    config.memory_index_1 = 0;
+    config.memory_index_2 = 1;
+    config.num_vector_1   = kNumVector;
+    config.num_timestep_1 = kNumTimestep;
+    config.is_prefetch    = 1;
+    config.is_eager       = is_eager;
+    NVUINTW(128) data;
+    config.ConfigRead(0x01, data);
+    AxiWrite(0x700010, data);
+    config.ConfigRead(0x02, data);
+    AxiWrite(0x700020, data);
+  }
+
+  void Load() {
+    NVUINTW(128) large_config = 0;
+    for (unsigned r = 0; r < 2; r++) {
+      large_config.set_slc<8>(32*r, NVUINT8(kNumVector));
+      large_config.set_slc<16>(32*r+16, NVUINT16(RegionBase(r)));
+    }
+    AxiWrite(0x400010, large_config);
+
+    x.clear();
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < kNumVector; v++) {
+        spec::VectorType vec;
+        for (unsigned k = 0; k < 16; k++) {
+          vec[k] = nvhls::get_rand<8>();
+        }
+        x.push_back(vec);
+        AxiWrite(LargeAddr(RegionBase(0), t, v), vec.to_rawbits());
+      }
+    }
+  }
+
+  void Poison() {
+    spec::VectorType poison;
+    for (unsigned k = 0; k < 16; k++) {
+      poison[k] = kPoison;
+    }
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < kNumVector; v++) {
+        AxiWrite(LargeAddr(RegionBase(1), t, v), poison.to_rawbits());
+      }
+    }
+  }
+
+  void Check() {
+    for (unsigned t = 0; t < kNumTimestep; t++) {
+      for (unsigned v = 0; v < kNumVector; v++) {
+        spec::VectorType out_vec(AxiRead(LargeAddr(RegionBase(1), t, v)));
+        for (unsigned k = 0; k < 16; k++) {
+          assert(out_vec[k] == spec::ScalarType(x[t*kNumVector + v][k] + 1));
+        }
+      }
+    }
+  }
+
+  void run() {
+    wait();
+
+    Load();
+    for (unsigned is_eager = 0; is_eager < 2; is_eager++) {
+      Poison();
+      Config(is_eager);
+      AxiWrite(0x1 << 4, 0);
+      unsigned cycle = 1;
+      bool done_reg;
+      while (!done.PopNB(done_reg)) {
+        cycle++;
+        wait();
+      }
+      cout << "Prefetch without input double buffering, is_eager " << is_eager
+           << ", " << kNumTimestep << " timesteps: " << cycle << " cycles" << endl;
+      Check();
+    }
+
+    is_finished = 1;
+    cout << sc_time_stamp() << " prefetch checks passed" << endl;
+  } // run()
+
+}; //SC MODULE Source
+
+// PE group 0 without input double buffering: inputs are only taken while idle,
+//   a start received while running is applied once done
+SC_MODULE(Dest) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::In<spec::StreamType>  data_out;
+  Connections::In<bool>              pe_start;
+  Connections::Out<spec::StreamType> data_in;
+  Connections::Out<bool>             pe_done;
+
+  bool is_run;
+  unsigned num_done;
+
+  SC_CTOR(Dest) {
+    SC_THREAD(PERun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void PERun() {
+    spec::VectorType in_regs[kNumVector];
+    unsigned in_counter = 0, out_counter = 0, run_counter = 0;
+    bool     is_start_pending = 0;
+    is_run = 0;
+    num_done = 0;
+    wait();
+    while (1) {
+      spec::StreamType data_out_reg;
+      if (!is_run && data_out.PopNB(data_out_reg)) {
+        // x(t+1) only, nothing past it before the start
+        assert(data_out_reg.group == 0);
+        assert((in_counter < kNumVector) && (data_out_reg.logical_addr == in_counter));
+        in_regs[in_counter] = data_out_reg.data;
+        in_counter++;
+      }
+
+      bool start_reg;
+      if (!is_start_pending && pe_start.PopNB(start_reg)) {
+        is_start_pending = 1;
+      }
+      if (!is_run && is_start_pending && (in_counter == kNumVector)) {
+        is_start_pending = 0;
+        is_run = 1;
+        in_counter = 0;
+        out_counter = 0;
+        run_counter = 0;
+      }
+      else if (is_run && (++run_counter > kRunCycles)) {
+        if (out_counter < kNumVector) {
+          spec::StreamType data_in_reg;
+          for (unsigned k = 0; k < 16; k++) {
+            data_in_reg.data[k] = in_regs[out_counter][k] + 1;
+          }
+          data_in_reg.index = 0;
+          data_in_reg.logical_addr = out_counter;
+          data_in_reg.group = 0;
+          data_in_reg.pe_src = 0;
+          if (data_in.PushNB(data_in_reg)) {
+            out_counter++;
+          }
+        }
+        else {
+          pe_done.Push(1);
+          is_run = 0;
+          num_done++;
+        }
+      }
+      wait();
+    } // while
+  } //PERun
+
+}; //SC MODULE Dest
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
+  Connections::Combinational<spec::StreamType> data_in;
+  Connections::Combinational<spec::StreamType> data_out;
+  Connections::Combinational<bool> pe_start;
+  Connections::Combinational<bool> pe_done;
+  Connections::Combinational<bool> pe_start_1;
+  Connections::Combinational<bool> pe_done_1;
+  sc_signal<spec::PEMaskType>      pe_group;
+  sc_signal<spec::PEMaskType>      pe_done_status;
+  Connections::Combinational<bool> done;
+
+  NVHLS_DESIGN(GBModule) dut;
+  Source  source;
+  Dest    dest;
+
+  bool is_held_seen;   // GBControl held a prefetched vector while the PE was running
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    dut("dut"),
+    source("source"),
+    dest("dest")
+  {
+
+    dut.clk(clk);
+    dut.rst(rst);
+    dut.rva_in(rva_in);
+    dut.rva_out(rva_out);
+    dut.data_out(data_out);
+    dut.data_in(data_in);
+    dut.done(done);
+    dut.pe_done(pe_done);
+    dut.pe_start_1(pe_start_1);
+    dut.pe_done_1(pe_done_1);
+    dut.pe_group(pe_group);
+    dut.pe_done_status(pe_done_status);
+    dut.pe_start(pe_start);
+
+    source.clk(clk);
+    source.rst(rst);
+    source.rva_in(rva_in);
+    source.rva_out(rva_out);
+    source.done(done);
+
+    dest.clk(clk);
+    dest.rst(rst);
+    dest.data_out(data_out);
+    dest.pe_start(pe_start);
+    dest.data_in(data_in);
+    dest.pe_done(pe_done);
+
+    SC_THREAD(MonitorRun);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+
+    SC_THREAD(run);
+  }
+
+  void MonitorRun() {
+    pe_start_1.ResetRead();
+    pe_done_1.ResetWrite();
+    is_held_seen = 0;
+    wait();
+    while (1) {
+      if (dest.is_run && dut.gbcontrol_inst.is_return_held) {
+        is_held_seen = 1;
+      }
+      wait();
+    }
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(20000, SC_NS );
+    assert(source.is_finished);
+    assert(dest.num_done == 2*kNumTimestep);
+    assert(is_held_seen);
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+}; //SC Module testbench
+
+int sc_main(int argc, char *argv[]) {
+  nvhls::set_random_seed();
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
@@ -51,6 +51,11 @@ SC_MODULE(GBPartition) {
   Connections::Out<spec::StreamType>  data_out;
   Connections::Out<bool>              pe_start;
   Connections::In<bool>               pe_done;  
+  // Layer pipelining: start/done of PE group 1, and the group of each PE
+  Connections::Out<bool>              pe_start_1;
+  Connections::In<bool>               pe_done_1;  
+  sc_out<spec::PEMaskType>            pe_group;
+  sc_in<spec::PEMaskType>             pe_done_status;   // PEs done with the current timestep
  
   Connections::Combinational<spec::Axi::SlaveToRVA::Write>     rva_in;
   Connections::Combinational<spec::Axi::SlaveToRVA::Read>      rva_out;
@@ -84,6 +89,10 @@ SC_MODULE(GBPartition) {
     gbmodule_inst.data_out(data_out);
     gbmodule_inst.pe_start(pe_start);
     gbmodule_inst.pe_done(pe_done);  
+    gbmodule_inst.pe_start_1(pe_start_1);
+    gbmodule_inst.pe_done_1(pe_done_1);  
+    gbmodule_inst.pe_group(pe_group);
+    gbmodule_inst.pe_done_status(pe_done_status);
   }      
   
 };
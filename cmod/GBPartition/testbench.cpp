@@ -142,6 +142,9 @@ SC_MODULE(testbench) {
   Connections::Combinational<spec::StreamType>  data_in;
   Connections::Combinational<spec::StreamType>  data_out;
   Connections::Combinational<bool>              pe_done;  
+  Connections::Combinational<bool>              pe_start_done_1;  // PE group 1 start looped back as its done
+  sc_signal<spec::PEMaskType>                   pe_group;
+  sc_signal<spec::PEMaskType>                   pe_done_status;
   Connections::Combinational<bool>              done;  
   Connections::Combinational<bool>            pe_start;
 
@@ -175,6 +178,10 @@ SC_MODULE(testbench) {
     dut.data_in(data_in);
     dut.data_out(data_out);
     dut.pe_done(pe_done);
+    dut.pe_start_1(pe_start_done_1);
+    dut.pe_done_1(pe_start_done_1);
+    dut.pe_group(pe_group);
+    dut.pe_done_status(pe_done_status);
     dut.done(done);
     dut.pe_start(pe_start);
 
@@ -55,6 +55,7 @@ class ActUnit : public match::Module {
   
   Connections::Out<spec::Axi::SlaveToRVA::Read> rva_out;
   Connections::Out<spec::StreamType> output_port;
+  Connections::Out<spec::StreamType> feedback_port;   // OUTPE -> PECore chain manager input
   Connections::Out<bool> done;
   
  protected:
@@ -81,6 +82,7 @@ class ActUnit : public match::Module {
         rva_in("rva_in"),
         rva_out("rva_out"),
         output_port("output_port"),
+        feedback_port("feedback_port"),
         done("done")
   {
     SC_THREAD(ActUnitRun);
@@ -102,7 +104,7 @@ class ActUnit : public match::Module {
   
   // while loop internal states
 //  bool w_axi_req, w_axi_rsp, w_out, w_load, w_done;
-  bool w_axi_rsp, w_out, w_load, w_done;      
+  bool w_axi_rsp, w_out, w_load, w_done, w_feedback;      
   bool is_incr;
   spec::Axi::SlaveToRVA::Read rva_out_reg;  
   //NVUINT8 curr_inst;
@@ -121,6 +123,7 @@ class ActUnit : public match::Module {
     rva_in.Reset();
     rva_out.Reset();
     output_port.Reset();
+    feedback_port.Reset();
     done.Reset();
   }
   
@@ -186,6 +189,7 @@ class ActUnit : public match::Module {
     w_out = 0;
     w_load = 0;
     w_done = 0;
+    w_feedback = 0;
     is_incr = 1;
   }  
   
@@ -253,6 +257,14 @@ class ActUnit : public match::Module {
         w_out = 1;
         break;
       }
+      case 0x5: { // OUTPE A2 -> PECore
+        w_feedback = 1;
+        break;
+      }
+      case 0x6: { // ESUB
+        ESub(act_regs[a2], act_regs[a1], act_regs[a2]); 
+        break;
+      }
       case 0x7: { // COPY A1 -> A2
         act_regs[a2] = act_regs[a1];
         break;      
@@ -339,6 +351,22 @@ class ActUnit : public match::Module {
     }
   }
   
+  // chained PE pass: A2 becomes input vector output_counter of the PECore chain 
+  //   manager, PECore accepts it in any state so the blocking push cannot
+  //   deadlock with its act_port push (INPE is not executed while waiting)
+  void PushFeedback(ActConfig act_config_in) {
+    if (w_feedback) {
+      spec::StreamType feedback_port_reg;
+      NVUINT8 curr_inst = act_config_in.InstFetch();
+      NVUINT2 a2 = nvhls::get_slc<2>(curr_inst, 2);
+      Fixed2Adpfloat(act_regs[a2], feedback_port_reg.data, act_config_in.adpfloat_bias);
+      feedback_port_reg.index = 0;
+      feedback_port_reg.logical_addr = act_config_in.output_counter;
+      
+      feedback_port.Push(feedback_port_reg);
+    }
+  }
+  
   void PushAxiRsp() {
     // use out valid to check for axi read on sram
     if (w_axi_rsp) {
@@ -371,6 +399,7 @@ class ActUnit : public match::Module {
       }
       else {
         PushOutput(act_config);      
+        PushFeedback(act_config);
         RunLoad(act_config);
         if (is_incr) {
           bool is_end;
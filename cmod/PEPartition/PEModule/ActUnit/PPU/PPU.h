@@ -115,6 +115,17 @@ void EAdd (const spec::ActVectorType in_1, const spec::ActVectorType in_2, spec:
   out = out_tmp;    
 }
 
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+void ESub (const spec::ActVectorType in_1, const spec::ActVectorType in_2, spec::ActVectorType& out)  {
+  spec::ActVectorType out_tmp; 
+  #pragma hls_unroll yes
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {  
+    out_tmp[i] = in_1[i] - in_2[i];
+  }  
+  out = out_tmp;    
+}
+
 #pragma hls_design ccore
 #pragma hls_ccore_type combinational
 void Relu (const spec::ActVectorType in, spec::ActVectorType& out) {
@@ -253,6 +253,7 @@ SC_MODULE(testbench) {
   Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
   Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
   Connections::Combinational<spec::StreamType> output_port; 
+  Connections::Combinational<spec::StreamType> feedback_port;
   
   Connections::Combinational<bool> start;
   Connections::Combinational<bool> done;
@@ -276,6 +277,7 @@ SC_MODULE(testbench) {
 		dut.rva_in(rva_in);
 		dut.rva_out(rva_out);		
 		dut.output_port(output_port);
+    dut.feedback_port(feedback_port);
     dut.start(start);
     dut.done(done);		
     
@@ -0,0 +1,322 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "PEPartition/PEModule/PEModule.h"
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+#include <nvhls_int.h>
+#include <nvhls_types.h>
+#include <nvhls_vector.h>
+
+#include "SM6Spec.h"
+#include "AxiSpec.h"
+#include "AdpfloatSpec.h"
+#include "AdpfloatUtils.h"
+
+#include "helper.h"
+
+#define NVHLS_VERIFY_BLOCKS (PEModule)
+#include <nvhls_verify.h>
+
+
+#ifdef COV_ENABLE
+   #pragma CTC SKIP
+#endif
+
+// Chained matrix vector mul (PEConfig.is_chain) through PECore and ActUnit on random data:
+//   manager 0 computes kNumOutput rows, the ActUnit program INPE, OUTPE sends each row
+//   back (feedback_port) as input of the chain manager, PECore WAITs for all of them and
+//   runs the chained row, the chain program INPE, OUTGB puts it on output_port.
+//   The output is checked bit-exact, with the plain and the pipelined PECore FSM
+
+const unsigned kNumInput     = 1;   // input vectors of manager 0
+const unsigned kNumOutput    = 2;   // rows of manager 0 = inputs of the chain manager
+const int kAdpbiasWeight = 2;
+const int kAdpbiasInput  = 2;
+const int kAdpbiasBias   = 3;
+const int kAdpbiasAct    = 5;       // ActUnit output, also chain manager input
+
+// weights, inputs and biases of one PEManager
+struct Layer {
+  unsigned num_input;
+  unsigned num_output;
+  int adpbias_input;
+  unsigned base_weight, base_bias, base_input;
+  std::vector<spec::VectorType> weight;   // (row*num_input + input)*16 + lane
+  std::vector<spec::VectorType> input;
+  std::vector<spec::VectorType> bias;
+};
+
+SC_MODULE(Source) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::Out<bool> start;
+  Connections::Out<spec::StreamType> input_port;
+  Connections::Out<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::In<spec::Axi::SlaveToRVA::Read>   rva_out;
+  Connections::In<spec::StreamType>              output_port;
+  Connections::In<bool>                          done;
+
+  Layer layer, chain;
+  bool is_finished;
+
+  SC_CTOR(Source) {
+    is_finished = 0;
+    SC_THREAD(run);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void AxiWrite(const unsigned addr, const NVUINTW(128) data) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 1;
+    rva_in_src.addr = addr;
+    rva_in_src.data = data;
+    rva_in.Push(rva_in_src);
+    wait();
+  }
+
+  spec::VectorType RandVector() {
+    spec::VectorType vec;
+    for (unsigned k = 0; k < 16; k++) {
+      vec[k] = nvhls::get_rand<8>();
+    }
+    return vec;
+  }
+
+  NVUINTW(128) ManagerConfig(const Layer& l) {
+    NVUINTW(128) data = 0;
+    data.set_slc<8>(8,  NVUINT8(kAdpbiasWeight));
+    data.set_slc<8>(16, NVUINT8(kAdpbiasBias));
+    data.set_slc<8>(24, NVUINT8(l.adpbias_input));
+    data.set_slc<8>(32, NVUINT8(l.num_input));
+    data.set_slc<16>(48, NVUINT16(l.base_weight));
+    data.set_slc<16>(64, NVUINT16(l.base_bias));
+    data.set_slc<16>(80, NVUINT16(l.base_input));
+    return data;
+  }
+
+  // weights and biases to PE SRAM, inputs only if given
+  void Load(Layer& l, const unsigned local_index) {
+    l.weight.clear();
+    l.bias.clear();
+    for (unsigned e = 0; e < l.num_output*l.num_input*16; e++) {
+      l.weight.push_back(RandVector());
+      AxiWrite(0x500000 + (l.base_weight + e)*16, l.weight[e].to_rawbits());
+    }
+    for (unsigned o = 0; o < l.num_output; o++) {
+      l.bias.push_back(RandVector());
+      AxiWrite(0x600000 + (l.base_bias + o)*16, l.bias[o].to_rawbits());
+    }
+    for (unsigned i = 0; i < l.input.size(); i++) {
+      AxiWrite(0x600000 + (l.base_input + i)*16, l.input[i].to_rawbits());
+    }
+    AxiWrite(0x400000 + local_index*16, ManagerConfig(l));
+  }
+
+  // Row o of a manager as PECore::ComputeAct, MAC truncated to kActNumFrac plus bias, saturated
+  spec::ActVectorType ActRef(const Layer& l, const unsigned o) const {
+    spec::ActVectorType act;
+    for (unsigned k = 0; k < 16; k++) {
+      double sum = 0;
+      for (unsigned i = 0; i < l.num_input; i++) {
+        for (unsigned j = 0; j < 16; j++) {
+          AdpfloatType<8,3> w_tmp(l.weight[(o*l.num_input + i)*16 + k][j]);
+          AdpfloatType<8,3> x_tmp(l.input[i][j]);
+          sum += (double) w_tmp.to_float(kAdpbiasWeight) * x_tmp.to_float(l.adpbias_input);
+        }
+      }
+      AdpfloatType<8,3> b_tmp(l.bias[o][k]);
+      long act_tmp = (long) floor(sum * (1 << spec::kActNumFrac));
+      act_tmp += (long) (b_tmp.to_float(kAdpbiasBias) * (1 << spec::kActNumFrac));
+      if (act_tmp > spec::kActWordMax)
+        act_tmp = spec::kActWordMax;
+      else if (act_tmp < spec::kActWordMin)
+        act_tmp = spec::kActWordMin;
+      act[k] = act_tmp;
+    }
+    return act;
+  }
+
+  void RunChain(const bool is_pipeline) {
+    // valid, bias, 1 manager, 2 outputs, (pipeline), chain with 1 output, num_batch 1
+    if (is_pipeline) {
+      AxiWrite(0x400010, set_bytes<16>("00_01_01_01_00_00_00_01_00_00_02_01_01_00_00_01"));
+    }
+    else {
+      AxiWrite(0x400010, set_bytes<16>("00_01_01_01_00_00_00_00_00_00_02_01_01_00_00_01"));
+    }
+
+    // INPE A0, OUTPE A0 per row, then INPE A0, OUTGB A0 for the chained row
+    ActConfig act_config;
+    act_config.Reset();
+    act_config.is_valid         = 1;
+    act_config.adpfloat_bias    = kAdpbiasAct;
+    act_config.num_inst         = 2;
+    act_config.num_output       = kNumOutput;
+    act_config.num_inst_chain   = 2;
+    act_config.num_output_chain = 1;
+    act_config.inst_base_chain  = 2;
+    for (unsigned i = 0; i < 16; i++) {
+      act_config.inst_regs[i] = 0;
+    }
+    act_config.inst_regs[0] = 0x30;
+    act_config.inst_regs[1] = 0x50;
+    act_config.inst_regs[2] = 0x30;
+    act_config.inst_regs[3] = 0x40;
+    NVUINTW(128) act_data;
+    act_config.ActConfigRead(0x01, act_data);
+    AxiWrite(0x800010, act_data);
+    act_config.ActConfigRead(0x02, act_data);
+    AxiWrite(0x800020, act_data);
+    start.Push(1);
+
+    // feedback vectors as ActUnit converts them
+    chain.input.clear();
+    for (unsigned o = 0; o < kNumOutput; o++) {
+      spec::VectorType feedback;
+      Fixed2Adpfloat(ActRef(layer, o), feedback, kAdpbiasAct);
+      chain.input.push_back(feedback);
+    }
+    spec::VectorType out_ref;
+    Fixed2Adpfloat(ActRef(chain, 0), out_ref, kAdpbiasAct);
+
+    spec::StreamType output_reg = output_port.Pop();
+    assert(output_reg.logical_addr == 0);
+    for (unsigned k = 0; k < 16; k++) {
+      assert(output_reg.data[k] == out_ref[k]);
+    }
+    done.Pop();
+    cout << sc_time_stamp() << " chain pipeline " << is_pipeline << " passed" << endl;
+  }
+
+  void run() {
+    wait();
+    layer.num_input     = kNumInput;
+    layer.num_output    = kNumOutput;
+    layer.adpbias_input = kAdpbiasInput;
+    layer.base_weight   = 0;
+    layer.base_bias     = 0x10;
+    layer.base_input    = 0;
+    for (unsigned i = 0; i < kNumInput; i++) {
+      layer.input.push_back(RandVector());
+    }
+    Load(layer, 0x2);
+
+    // inputs come from feedback_port
+    chain.num_input     = kNumOutput;
+    chain.num_output    = 1;
+    chain.adpbias_input = kAdpbiasAct;
+    chain.base_weight   = 0x100;
+    chain.base_bias     = 0x20;
+    chain.base_input    = 0x8;
+    Load(chain, 0x6);
+
+    RunChain(0);
+    RunChain(1);
+
+    // nothing more than the chained row
+    spec::StreamType output_reg;
+    for (unsigned i = 0; i < 100; i++) {
+      assert(!output_port.PopNB(output_reg));
+      wait();
+    }
+    is_finished = 1;
+  } // run()
+
+}; //SC MODULE Source
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<spec::StreamType> input_port;
+  Connections::Combinational<bool> start;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
+  Connections::Combinational<spec::StreamType> output_port;
+  Connections::Combinational<bool> done;
+
+  NVHLS_DESIGN(PEModule) dut;
+  Source  source;
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    dut("dut"),
+    source("source")
+  {
+    dut.clk(clk);
+    dut.rst(rst);
+    dut.input_port(input_port);
+    dut.start(start);
+    dut.rva_in(rva_in);
+    dut.rva_out(rva_out);
+    dut.output_port(output_port);
+    dut.done(done);
+
+    source.clk(clk);
+    source.rst(rst);
+    source.start(start);
+    source.input_port(input_port);
+    source.rva_in(rva_in);
+    source.rva_out(rva_out);
+    source.output_port(output_port);
+    source.done(done);
+
+    SC_THREAD(run);
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(10000, SC_NS );
+    assert(source.is_finished);
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+}; //SC Module testbench
+
+int sc_main(int argc, char *argv[]) {
+  nvhls::set_random_seed();
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
@@ -0,0 +1,329 @@
+/*
+ * All rights reserved - Harvard University.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <systemc.h>
+#include <mc_scverify.h>
+#include <testbench/nvhls_rand.h>
+#include <nvhls_connections.h>
+#include <vector>
+#include <cstdlib>
+#include <math.h> // testbench only
+#include <iomanip>
+
+#include "PEPartition/PEModule/PECore/PECore.h"
+
+#include "SM6Spec.h"
+#include "AxiSpec.h"
+#include "AdpfloatSpec.h"
+#include "AdpfloatUtils.h"
+
+#include "helper.h"
+
+#define NVHLS_VERIFY_BLOCKS (PECore)
+#include <nvhls_verify.h>
+
+#ifdef COV_ENABLE
+   #pragma CTC SKIP
+#endif
+
+// PECore modes on random data, act_port outputs are checked bit-exact against
+//   the MAC of the adpfloat values (truncated to kActNumFrac) plus bias:
+//   GRU (is_gru) with two managers, r/z rows give one vector with the sum of both
+//   managers, n rows one vector per manager, for the plain and the pipelined FSM;
+//   batch mode (num_batch 3 and 4) with one manager, num_batch vectors per row,
+//   is_input_dbuf requested as well and not used (PE_BATCH build, see Makefile)
+
+const unsigned kNumManager   = 2;   // x-side and h-side
+const unsigned kNumInput     = 2;   // input vectors per manager
+const unsigned kNumOutput    = 6;   // two row triplets (r, z, n)
+const unsigned kBatchBase    = 0x40;  // input i of batch b at kBatchBase + i*num_batch + b
+const int kAdpbiasWeight = 2;
+const int kAdpbiasInput  = 2;
+const int kAdpbiasBias   = 3;
+
+SC_MODULE(Source) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::Out<bool> start;
+  Connections::Out<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::In<spec::Axi::SlaveToRVA::Read>   rva_out;
+  Connections::In<spec::ActVectorType>           act_port;
+
+  // weight entry (row*kNumInput + input)*16 + lane, one per manager
+  std::vector<spec::VectorType> weight[kNumManager];
+  std::vector<spec::VectorType> input[kNumManager];
+  std::vector<spec::VectorType> bias[kNumManager];
+  std::vector<spec::VectorType> batch_input;
+  bool is_finished;
+
+  SC_CTOR(Source) {
+    is_finished = 0;
+    SC_THREAD(run);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void AxiWrite(const unsigned addr, const NVUINTW(128) data) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 1;
+    rva_in_src.addr = addr;
+    rva_in_src.data = data;
+    rva_in.Push(rva_in_src);
+    wait();
+  }
+
+  NVUINTW(128) AxiRead(const unsigned addr) {
+    spec::Axi::SlaveToRVA::Write rva_in_src;
+    rva_in_src.rw = 0;
+    rva_in_src.addr = addr;
+    rva_in_src.data = 0;
+    rva_in.Push(rva_in_src);
+    spec::Axi::SlaveToRVA::Read rva_out_dest = rva_out.Pop();
+    wait();
+    return rva_out_dest.data;
+  }
+
+  unsigned WeightBase(const unsigned m) const { return m*kNumOutput*kNumInput*16; }
+  unsigned BiasBase(const unsigned m) const { return 0x10 + m*0x10; }
+  unsigned InputBase(const unsigned m) const { return m*kNumInput; }
+
+  spec::VectorType RandVector() {
+    spec::VectorType vec;
+    for (unsigned k = 0; k < 16; k++) {
+      vec[k] = nvhls::get_rand<8>();
+    }
+    return vec;
+  }
+
+  NVUINTW(128) ManagerConfig(const unsigned m, const unsigned base_input) {
+    NVUINTW(128) data = 0;
+    data.set_slc<8>(8,  NVUINT8(kAdpbiasWeight));
+    data.set_slc<8>(16, NVUINT8(kAdpbiasBias));
+    data.set_slc<8>(24, NVUINT8(kAdpbiasInput));
+    data.set_slc<8>(32, NVUINT8(kNumInput));
+    data.set_slc<16>(48, NVUINT16(WeightBase(m)));
+    data.set_slc<16>(64, NVUINT16(BiasBase(m)));
+    data.set_slc<16>(80, NVUINT16(base_input));
+    return data;
+  }
+
+  void Load() {
+    for (unsigned m = 0; m < kNumManager; m++) {
+      weight[m].clear();
+      input[m].clear();
+      bias[m].clear();
+      for (unsigned e = 0; e < kNumOutput*kNumInput*16; e++) {
+        weight[m].push_back(RandVector());
+        AxiWrite(0x500000 + (WeightBase(m) + e)*16, weight[m][e].to_rawbits());
+      }
+      for (unsigned i = 0; i < kNumInput; i++) {
+        input[m].push_back(RandVector());
+        AxiWrite(0x600000 + (InputBase(m) + i)*16, input[m][i].to_rawbits());
+      }
+      for (unsigned o = 0; o < kNumOutput; o++) {
+        bias[m].push_back(RandVector());
+        AxiWrite(0x600000 + (BiasBase(m) + o)*16, bias[m][o].to_rawbits());
+      }
+      AxiWrite(0x400000 + (0x2 + 2*m)*16, ManagerConfig(m, InputBase(m)));
+    }
+  }
+
+  long Saturate(const long act) const {
+    if (act > spec::kActWordMax) return spec::kActWordMax;
+    if (act < spec::kActWordMin) return spec::kActWordMin;
+    return act;
+  }
+
+  // Row o, lane k of manager m on the inputs x as PECore::ComputeAct
+  long ActRef(const unsigned m, const std::vector<spec::VectorType>& x, 
+              const unsigned o, const unsigned k) const {
+    double sum = 0;
+    for (unsigned i = 0; i < kNumInput; i++) {
+      for (unsigned j = 0; j < 16; j++) {
+        AdpfloatType<8,3> w_tmp(weight[m][(o*kNumInput + i)*16 + k][j]);
+        AdpfloatType<8,3> x_tmp(x[i][j]);
+        sum += (double) w_tmp.to_float(kAdpbiasWeight) * x_tmp.to_float(kAdpbiasInput);
+      }
+    }
+    AdpfloatType<8,3> b_tmp(bias[m][o][k]);
+    long act = (long) floor(sum * (1 << spec::kActNumFrac));
+    act += (long) (b_tmp.to_float(kAdpbiasBias) * (1 << spec::kActNumFrac));
+    return Saturate(act);
+  }
+
+  void CheckAct(const std::vector<long>& act_ref) {
+    spec::ActVectorType act_reg = act_port.Pop();
+    for (unsigned k = 0; k < 16; k++) {
+      assert(act_reg[k].to_int64() == act_ref[k]);
+    }
+  }
+
+  void RunGru(const bool is_pipeline) {
+    // valid, bias, 2 managers, 6 outputs, (pipeline), gru, num_batch 1
+    if (is_pipeline) {
+      AxiWrite(0x400010, set_bytes<16>("00_01_00_00_01_00_00_01_00_00_06_02_01_00_00_01"));
+    }
+    else {
+      AxiWrite(0x400010, set_bytes<16>("00_01_00_00_01_00_00_00_00_00_06_02_01_00_00_01"));
+    }
+    start.Push(1);
+
+    for (unsigned o = 0; o < kNumOutput; o++) {
+      if (o % 3 != 2) {
+        std::vector<long> act_ref;
+        for (unsigned k = 0; k < 16; k++) {
+          act_ref.push_back(Saturate(ActRef(0, input[0], o, k) + ActRef(1, input[1], o, k)));
+        }
+        CheckAct(act_ref);
+      }
+      else {
+        for (unsigned m = 0; m < kNumManager; m++) {
+          std::vector<long> act_ref;
+          for (unsigned k = 0; k < 16; k++) {
+            act_ref.push_back(ActRef(m, input[m], o, k));
+          }
+          CheckAct(act_ref);
+        }
+      }
+    }
+    cout << sc_time_stamp() << " GRU pipeline " << is_pipeline << " passed" << endl;
+  }
+
+  void RunBatch(const unsigned num_batch) {
+    batch_input.clear();
+    for (unsigned e = 0; e < kNumInput*num_batch; e++) {
+      batch_input.push_back(RandVector());
+      AxiWrite(0x600000 + (kBatchBase + e)*16, batch_input[e].to_rawbits());
+    }
+    AxiWrite(0x400020, ManagerConfig(0, kBatchBase));
+
+    // valid, bias, 1 manager, 6 outputs, input_dbuf (unused in batch mode), num_batch
+    NVUINTW(128) config = set_bytes<16>("00_00_00_00_00_01_00_00_00_00_06_01_01_00_00_01");
+    config.set_slc<8>(112, NVUINT8(num_batch));
+    AxiWrite(0x400010, config);
+    assert(AxiRead(0x400010) == config);
+    start.Push(1);
+
+    for (unsigned o = 0; o < kNumOutput; o++) {
+      for (unsigned b = 0; b < num_batch; b++) {
+        std::vector<spec::VectorType> x;
+        for (unsigned i = 0; i < kNumInput; i++) {
+          x.push_back(batch_input[i*num_batch + b]);
+        }
+        std::vector<long> act_ref;
+        for (unsigned k = 0; k < 16; k++) {
+          act_ref.push_back(ActRef(0, x, o, k));
+        }
+        CheckAct(act_ref);
+      }
+    }
+    cout << sc_time_stamp() << " batch " << num_batch << " passed" << endl;
+  }
+
+  void run() {
+    wait();
+    Load();
+    RunGru(0);
+    RunGru(1);
+    RunBatch(3);
+    RunBatch(4);
+
+    // nothing more than the rows above
+    spec::ActVectorType act_reg;
+    for (unsigned i = 0; i < 100; i++) {
+      assert(!act_port.PopNB(act_reg));
+      wait();
+    }
+    is_finished = 1;
+  } // run()
+
+}; //SC MODULE Source
+
+SC_MODULE(testbench) {
+  SC_HAS_PROCESS(testbench);
+  sc_clock clk;
+  sc_signal<bool> rst;
+
+  Connections::Combinational<bool> start;
+  Connections::Combinational<spec::StreamType> input_port;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
+  Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
+  Connections::Combinational<spec::ActVectorType> act_port;
+  Connections::Combinational<spec::StreamType> feedback_port;
+  sc_signal<NVUINT32> sram_config;
+
+  NVHLS_DESIGN(PECore) dut;
+  Source  source;
+
+  testbench(sc_module_name name)
+  : sc_module(name),
+    clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
+    rst("rst"),
+    dut("dut"),
+    source("source")
+  {
+    dut.clk(clk);
+    dut.rst(rst);
+    dut.start(start);
+    dut.input_port(input_port);
+    dut.rva_in(rva_in);
+    dut.rva_out(rva_out);
+    dut.act_port(act_port);
+    dut.feedback_port(feedback_port);
+    dut.SC_SRAM_CONFIG(sram_config);
+
+    source.clk(clk);
+    source.rst(rst);
+    source.start(start);
+    source.rva_in(rva_in);
+    source.rva_out(rva_out);
+    source.act_port(act_port);
+
+    SC_THREAD(run);
+  }
+
+  void run(){
+    wait(2, SC_NS );
+    std::cout << "@" << sc_time_stamp() <<" Asserting reset" << std::endl;
+    rst.write(false);
+    wait(2, SC_NS );
+    rst.write(true);
+    std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
+    wait(10000, SC_NS );
+    assert(source.is_finished);
+    std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
+    sc_stop();
+  }
+}; //SC Module testbench
+
+int sc_main(int argc, char *argv[]) {
+  nvhls::set_random_seed();
+
+  testbench tb("tb");
+  sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
+  sc_start();
+
+  bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
+  if (rc)
+    DCOUT("TESTBENCH FAIL" << endl);
+  else
+    DCOUT("TESTBENCH PASS" << endl);
+  return rc;
+}
@@ -42,6 +42,7 @@ class PECore : public match::Module {
   Connections::In<spec::Axi::SlaveToRVA::Write> rva_in;
   Connections::Out<spec::Axi::SlaveToRVA::Read> rva_out;
   Connections::Out<spec::ActVectorType> act_port;
+  Connections::In<spec::StreamType> feedback_port;    // ActUnit OUTPE (PEConfig.is_chain)
   sc_in <NVUINT32>  SC_SRAM_CONFIG;
   
   // single port weight SRAM
@@ -68,13 +69,46 @@ class PECore : public match::Module {
   
   // FSM
   enum FSM {
-    IDLE, PRE, MAC, BIAS, OUT
+    IDLE, PRE, MAC, BIAS, OUT, DRAIN, WAIT
   };  
+  static const int kNumStates = 7;
   FSM state;
   
-  // accumulator regs
-  spec::AccumVectorType accum_vector;   
-  spec::ActVectorType act_port_reg;   
+  // accumulator regs, one per batch (pe_config.num_batch)
+  spec::AccumVectorType accum_vector[spec::PE::kMaxBatch];   
+  spec::ActVectorType act_port_reg[spec::PE::kMaxBatch];   
+  NVUINT3 batch_counter;    // batch of the OUT push
+  // GRU (pe_config.is_gru): running sum of the managers of a r/z row
+  spec::ActVectorType act_fuse_reg;
+  
+  // pipelined mode (pe_config.is_pipeline): the finished row is retired
+  // (bias, saturation, act_port push) while the next row does MAC
+  bool is_pipeline_run;
+  bool w_bias_fetch;
+  bool w_mac_skip;
+  spec::VectorType row_bias;
+  bool retire_valid;
+  bool retire_fuse, retire_hold;
+  NVUINT4 retire_m_index;
+  spec::AccumVectorType retire_accum;
+  spec::VectorType retire_bias;
+  spec::VectorType input_cache[spec::PE::kNumPEManagers][spec::PE::kNumInputCache];
+  
+  // chained matrix vector mul (pe_config.is_chain): feedback vectors received
+  // in this run, WAIT until all pe_manager[kChainManager].num_input arrived
+  NVUINT8 chain_input_counter;
+  
+  // per-state cycle counters (while is_start), busy_cycles is the sum of
+  // PRE/MAC/BIAS/OUT/DRAIN/WAIT, IDLE is never counted (is_start clears
+  // with the move to IDLE)
+  NVUINT32 busy_cycles;
+  NVUINT32 state_cycles[kNumStates];
+  
+  // zero skipping (pe_config.is_zero_skip), one flag per input SRAM entry
+  // updated on every input SRAM write
+  NVUINTW(spec::PE::Input::kNumBanks*spec::PE::Input::kEntriesPerBank) input_zero_flags;
+  NVUINT32 skip_inputs;     // zero input vectors skipped
+  NVUINT32 skip_cycles;     // MAC cycles saved
     
   // Indicate the Computation part is activated 
   bool is_start;
@@ -83,6 +117,10 @@ class PECore : public match::Module {
   // while loop control signal (including SRAM I/O)
   bool w_axi_rsp;
   spec::Axi::SlaveToRVA::Read rva_out_reg;  
+  
+  // AXI request popped during ping-pong preload that has to wait for IDLE
+  bool is_rva_pending;
+  spec::Axi::SlaveToRVA::Write rva_in_pending;
 
   // SRAM buffer signals
   // Weight Buffer signals                           
@@ -117,6 +155,7 @@ class PECore : public match::Module {
         rva_in("rva_in"),
         rva_out("rva_out"),
         act_port("act_port"),
+        feedback_port("feedback_port"),
         SC_SRAM_CONFIG("SRAM_CONFIG")
   {
     SC_THREAD(PECoreRun);
@@ -128,11 +167,19 @@ class PECore : public match::Module {
   void Reset() {
     state = IDLE;
     is_start = 0; // bug fix 
+    is_rva_pending = 0;
+    is_pipeline_run = 0;
+    retire_valid = 0;
+    retire_fuse = 0;
+    retire_hold = 0;
+    chain_input_counter = 0;
+    input_zero_flags = 0;
     for (unsigned i = 0; i < spec::PE::kNumPEManagers; i++) {
       pe_manager[i].Reset();
     }
     pe_config.Reset();
     ResetAccum();
+    ResetCycleCounter();
     ResetPorts();
   }
 
@@ -142,12 +189,50 @@ class PECore : public match::Module {
     rva_in.Reset();
     rva_out.Reset();
     act_port.Reset();
+    feedback_port.Reset();
   }
 
 
   void ResetAccum() {
-    accum_vector = 0;
-    act_port_reg = 0;
+    #pragma hls_unroll yes
+    for (unsigned b = 0; b < spec::PE::kMaxBatch; b++) {
+      accum_vector[b] = 0;
+      act_port_reg[b] = 0;
+    }
+    batch_counter = 0;
+  }
+  
+  // GRU r/z row: add the act of manager m_index to the managers before it
+  void FuseAct(const bool is_fuse, const NVUINT4 m_index, const spec::ActVectorType& act_in, 
+               spec::ActVectorType& act_out) {
+    if (is_fuse) {
+      #pragma hls_unroll yes
+      for (int i = 0; i < spec::kNumVectorLanes; i++) {
+        NVINTW(spec::kActWordWidth+1) sum = act_in[i];
+        if (m_index != 0) {
+          sum += act_fuse_reg[i];
+        }
+        if (sum > spec::kActWordMax)
+          sum = spec::kActWordMax;
+        else if (sum < spec::kActWordMin)
+          sum = spec::kActWordMin;
+        act_out[i] = sum;
+      }
+      act_fuse_reg = act_out;
+    }
+    else {
+      act_out = act_in;
+    }
+  }
+  
+  void ResetCycleCounter() {
+    busy_cycles = 0;
+    skip_inputs = 0;
+    skip_cycles = 0;
+    #pragma hls_unroll yes
+    for (int i = 0; i < kNumStates; i++) {
+      state_cycles[i] = 0;
+    }
   }
   
   void ResetBufferInputs() {
@@ -161,9 +246,12 @@ class PECore : public match::Module {
     weight_write_req_valid     [0] = 0;
     weight_write_data          [0] = 0;
 
-    input_read_addrs          [0] = 0; 
-    input_read_req_valid      [0] = 0;  
-    input_read_ready          [0] = 0;  
+    #pragma hls_unroll yes 
+    for (unsigned i = 0; i < spec::PE::Input::kNumReadPorts; i++) { 
+      input_read_addrs          [i] = 0; 
+      input_read_req_valid      [i] = 0;  
+      input_read_ready          [i] = 0;  
+    }
     input_write_addrs         [0] = 0;
     input_write_req_valid     [0] = 0;
     input_write_data          [0] = 0;
@@ -171,6 +259,24 @@ class PECore : public match::Module {
   }
 /////////////////////////////
 
+  // Ping-pong buffering (pe_config.is_pingpong): the address MSB selects the
+  // SRAM half, datapath uses active_idx and AXI accesses the other half
+  spec::PE::Weight::Address WeightHalfAddr(spec::PE::Weight::Address addr, bool is_shadow) const {
+    if (pe_config.is_pingpong) {
+      NVUINT1 half = pe_config.active_idx ^ is_shadow;
+      addr.set_slc<1>(spec::PE::Weight::kAddressWidth-1, half);
+    }
+    return addr;
+  }
+
+  spec::PE::Input::Address InputHalfAddr(spec::PE::Input::Address addr, bool is_shadow) const {
+    if (pe_config.is_pingpong) {
+      NVUINT1 half = pe_config.active_idx ^ is_shadow;
+      addr.set_slc<1>(spec::PE::Input::kAddressWidth-1, half);
+    }
+    return addr;
+  }
+
   void DecodeAxiWrite(const spec::Axi::SlaveToRVA::Write& rva_in_reg){
     NVUINT4     tmp = nvhls::get_slc<4>(rva_in_reg.addr, 20);
     NVUINT16    local_index = nvhls::get_slc<16>(rva_in_reg.addr, 4);
@@ -180,6 +286,10 @@ class PECore : public match::Module {
         switch (local_index) {
           case 0x1: {
             pe_config.PEConfigWrite(rva_in_reg.data);
+            #pragma hls_unroll yes
+            for (unsigned i = 0; i < spec::PE::kNumPEManagers; i++) {
+              pe_manager[i].ResetInputBank();
+            }
             break;        
           }
           case 0x2: {     // manager 0 config
@@ -198,6 +308,18 @@ class PECore : public match::Module {
             pe_manager[1].ClusterWrite(rva_in_reg.data);
             break; 
           }          
+          case 0x6: {     // manager 2 config
+            pe_manager[2].PEManagerWrite(rva_in_reg.data);
+            break; 
+          }     
+          case 0x7: {     // manager 2 cluster
+            pe_manager[2].ClusterWrite(rva_in_reg.data);
+            break; 
+          }          
+          case 0x8: {     // cycle counters (write clears)
+            ResetCycleCounter();
+            break;
+          }
           default: {
             break;
           }
@@ -205,13 +327,13 @@ class PECore : public match::Module {
         break;
       }
       case 0x5: {     // Weight Buffer
-        weight_write_addrs         [0] = local_index;
+        weight_write_addrs         [0] = WeightHalfAddr(local_index, 1);
         weight_write_req_valid     [0] = 1;
         weight_write_data          [0] = rva_in_reg.data; 
         break;
       }
       case 0x6: {     // Input Buffer (lock datapath)
-        input_write_addrs         [0] = local_index;
+        input_write_addrs         [0] = InputHalfAddr(local_index, 1);
         input_write_req_valid     [0] = 1;
         input_write_data          [0] = rva_in_reg.data;       
         break;
@@ -264,6 +386,32 @@ class PECore : public match::Module {
             pe_manager[1].ClusterRead(rva_out_reg.data);
             break; 
           }
+          case 0x6: {     // manager 2 config
+            pe_manager[2].PEManagerRead(rva_out_reg.data);
+            break; 
+          }     
+          case 0x7: {     // manager 2 cluster
+            pe_manager[2].ClusterRead(rva_out_reg.data);
+            break; 
+          }
+          case 0x8: {     // cycle counters of PRE/MAC/BIAS/OUT
+            rva_out_reg.data.set_slc<32>(0,  state_cycles[PRE]);
+            rva_out_reg.data.set_slc<32>(32, state_cycles[MAC]);
+            rva_out_reg.data.set_slc<32>(64, state_cycles[BIAS]);
+            rva_out_reg.data.set_slc<32>(96, state_cycles[OUT]);
+            break;
+          }
+          case 0x9: {     // busy/drain cycles and zero skipping counters
+            rva_out_reg.data.set_slc<32>(0,  busy_cycles);
+            rva_out_reg.data.set_slc<32>(32, state_cycles[DRAIN]);
+            rva_out_reg.data.set_slc<32>(64, skip_inputs);
+            rva_out_reg.data.set_slc<32>(96, skip_cycles);
+            break;
+          }
+          case 0xA: {     // chained pass WAIT cycles
+            rva_out_reg.data.set_slc<32>(0,  state_cycles[WAIT]);
+            break;
+          }
           default: {
             break;
           }
@@ -272,14 +420,14 @@ class PECore : public match::Module {
       }
       case 0x5: {     // Weight Buffer
         //w_axir_weight = 1;  
-        weight_read_addrs          [0] = local_index;
+        weight_read_addrs          [0] = WeightHalfAddr(local_index, 1);
         weight_read_req_valid      [0] = 1;   
         weight_read_ready          [0] = 1;
         break;
       }
       case 0x6: {     // Input Buffer (lock datapath)
         //w_axir_input = 1;
-        input_read_addrs          [0] = local_index; 
+        input_read_addrs          [0] = InputHalfAddr(local_index, 1); 
         input_read_req_valid      [0] = 1;  
         input_read_ready          [0] = 1;    
         break;
@@ -301,6 +449,8 @@ class PECore : public match::Module {
   void Initialize() {
     ResetBufferInputs();
     w_axi_rsp     = 0;
+    w_bias_fetch  = 0;
+    w_mac_skip    = 0;
   }
   
   void CheckStart() {
@@ -314,7 +464,16 @@ class PECore : public match::Module {
   
   void DecodeAxi() {  
     spec::Axi::SlaveToRVA::Write rva_in_reg;
-    if (rva_in.PopNB(rva_in_reg)) {
+    bool is_rva = 0;
+    if (is_rva_pending) {
+      rva_in_reg = rva_in_pending;
+      is_rva_pending = 0;
+      is_rva = 1;
+    }
+    else {
+      is_rva = rva_in.PopNB(rva_in_reg);
+    }
+    if (is_rva) {
       //w_axi_req = 1;
       CDCOUT(sc_time_stamp()  << " PECore: " << name() << "RVA Pop " << endl, kDebugLevel);
       if(rva_in_reg.rw) {
@@ -326,20 +485,61 @@ class PECore : public match::Module {
     }  
   }
 
+  // Ping-pong preload while computing: only weight/input buffer writes
+  // (to the shadow half) are served, other requests are held until IDLE.
+  // An input buffer write also waits while the input stream uses the write port
+  void DecodeAxiPreload() {
+    if (state != IDLE) {
+      if (!is_rva_pending) {
+        is_rva_pending = rva_in.PopNB(rva_in_pending);
+      }
+      if (is_rva_pending && rva_in_pending.rw) {
+        NVUINT4 tmp = nvhls::get_slc<4>(rva_in_pending.addr, 20);
+        if (tmp == 0x5 || (tmp == 0x6 && !input_write_req_valid[0])) {
+          CDCOUT(sc_time_stamp()  << " PECore: " << name() << " RVA Preload " << endl, kDebugLevel);
+          DecodeAxiWrite(rva_in_pending);
+          is_rva_pending = 0;
+        }
+      }
+    }
+  }
+
+  // Can only pop message from GB buffer in IDLE state, 
+  //   unless input is double buffered (then streamed input goes to the other bank)
+  void RecvInput() {
+    if ((state == IDLE || pe_config.IsInputDbuf()) && !input_write_req_valid[0]) {
+      spec::StreamType input_port_reg; 
+      if (input_port.PopNB(input_port_reg)) {
+        NVUINT4   m_index = input_port_reg.index;
+        input_write_addrs         [0] = InputHalfAddr(pe_manager[m_index].GetInputStreamAddr(input_port_reg.logical_addr, pe_config.IsInputDbuf()), 0);
+        input_write_req_valid     [0] = 1;
+        input_write_data          [0] = input_port_reg.data;              
+        pe_manager[m_index].is_input_filled = 1;
+      }
+    }
+  }
+  
+  // Chained matrix vector mul: ActUnit feedback goes to the chain manager's input,
+  //   accepted in every state while running (ActUnit OUTPE is a blocking push 
+  //   between its INPEs), takes the input write port before the input stream
+  void RecvFeedback() {
+    if (is_start && pe_config.is_chain) {
+      spec::StreamType feedback_port_reg;
+      if (feedback_port.PopNB(feedback_port_reg)) {
+        input_write_addrs         [0] = InputHalfAddr(pe_manager[spec::PE::kChainManager].GetInputAddr(feedback_port_reg.logical_addr), 0);
+        input_write_req_valid     [0] = 1;
+        input_write_data          [0] = feedback_port_reg.data;
+        chain_input_counter += 1;
+      }
+    }
+  }
+  
   void RunFSM() {
     // Can do FSM only when and no Axi on input
     // Can only move forward to computation if is_start = 1
-    // Can only pop message from GB buffer in IDLE state
 
     switch (state) {
       case IDLE: {
-        spec::StreamType input_port_reg; 
-        if (input_port.PopNB(input_port_reg)) {
-          NVUINT4   m_index = input_port_reg.index;
-          input_write_addrs         [0] = pe_manager[m_index].GetInputAddr(input_port_reg.logical_addr);
-          input_write_req_valid     [0] = 1;
-          input_write_data          [0] = input_port_reg.data;              
-        }
         break;
       }
       case PRE: {
@@ -347,34 +547,80 @@ class PECore : public match::Module {
       }
       case MAC: {
         NVUINT4   m_index = pe_config.ManagerIndex();
+        bool is_row_begin = (pe_config.InputIndex() == 0);
+        
+        // Zero skipping: advance over all-zero input vectors without MAC, 
+        // w_mac_skip if no non-zero input is found in the window
+        if (pe_config.is_zero_skip && pe_config.NumBatch() == 1) {
+          NVUINT8 num_skip;
+          bool is_nonzero;
+          FindNonzeroInput(m_index, num_skip, is_nonzero);
+          if (is_nonzero) {
+            pe_config.SkipInputCounter(num_skip);
+            skip_cycles += num_skip;
+          }
+          else {
+            pe_config.SkipInputCounter(num_skip - 1);
+            skip_cycles += num_skip - 1;
+            w_mac_skip = 1;
+          }
+          skip_inputs += num_skip;
+        }
+        
         // Do MAC (Datapath)
         // set weight SRAM read
-        spec::PE::Weight::Address weight_base;
-        // clustering mode
-        if (pe_config.is_cluster) {
-          weight_base = pe_manager[m_index].GetWeightAddr(pe_config.InputIndex(), pe_config.OutputIndex(), 1);
-          #pragma hls_unroll yes
-          for (int i = 0; i < 8; i ++) {
-            weight_read_addrs          [i] = weight_base + i;
-            weight_read_req_valid      [i] = 1;   
-            weight_read_ready          [i] = 1;              
-          }     
-        }
-        // non-clustering mode 
-        else {
-          weight_base = pe_manager[m_index].GetWeightAddr(pe_config.InputIndex(), pe_config.OutputIndex(), 0);        
-          #pragma hls_unroll yes
-          for (int i = 0; i < 16; i ++) {
-            weight_read_addrs          [i] = weight_base + i;
-            weight_read_req_valid      [i] = 1;   
-            weight_read_ready          [i] = 1;              
-          }             
+        if (!w_mac_skip) {
+          spec::PE::Weight::Address weight_base;
+          // clustering mode
+          if (pe_config.is_cluster) {
+            weight_base = pe_manager[m_index].GetWeightAddr(pe_config.InputIndex(), pe_config.OutputIndex(), 1);
+            #pragma hls_unroll yes
+            for (int i = 0; i < 8; i ++) {
+              weight_read_addrs          [i] = WeightHalfAddr(weight_base + i, 0);
+              weight_read_req_valid      [i] = 1;   
+              weight_read_ready          [i] = 1;              
+            }     
+          }
+          // non-clustering mode 
+          else {
+            weight_base = pe_manager[m_index].GetWeightAddr(pe_config.InputIndex(), pe_config.OutputIndex(), 0);        
+            #pragma hls_unroll yes
+            for (int i = 0; i < 16; i ++) {
+              weight_read_addrs          [i] = WeightHalfAddr(weight_base + i, 0);
+              weight_read_req_valid      [i] = 1;   
+              weight_read_ready          [i] = 1;              
+            }             
+          }
         }
         
         // set input SRAM read
-        input_read_ready[0] = 1;
-        input_read_addrs[0] = pe_manager[m_index].GetInputAddr(pe_config.InputIndex());
-        input_read_req_valid[0] = 1;
+        // pipelined mode reads input SRAM only in the first row of each manager
+        // (input_cache afterwards), so the port can fetch the bias of the row
+        if (is_pipeline_run && pe_config.OutputIndex() != 0) {
+          if (pe_config.is_bias && is_row_begin) {
+            input_read_ready[0] = 1;
+            input_read_addrs[0] = InputHalfAddr(pe_manager[m_index].GetBiasAddr(pe_config.OutputIndex()), 0);
+            input_read_req_valid[0] = 1;
+            w_bias_fetch = 1;
+          }
+        }
+        else if (pe_config.NumBatch() != 1) {
+          // batch mode: the inputs of all batches are consecutive entries (one per bank)
+          #pragma hls_unroll yes
+          for (unsigned b = 0; b < spec::PE::kMaxBatch; b++) {
+            if (b < pe_config.NumBatch()) {
+              spec::PE::Input::Address batch_index = pe_config.InputIndex()*pe_config.NumBatch() + b;
+              input_read_ready[b] = 1;
+              input_read_addrs[b] = InputHalfAddr(pe_manager[m_index].GetInputAddr(batch_index), 0);
+              input_read_req_valid[b] = 1;
+            }
+          }
+        }
+        else if (!w_mac_skip) {
+          input_read_ready[0] = 1;
+          input_read_addrs[0] = InputHalfAddr(pe_manager[m_index].GetInputAddr(pe_config.InputIndex()), 0);
+          input_read_req_valid[0] = 1;
+        }
         
         break;  
       }
@@ -384,7 +630,7 @@ class PECore : public match::Module {
         // Set Bias SRAM read (on input SRAM)
         if (pe_config.is_bias) {
           input_read_ready[0] = 1;
-          input_read_addrs[0] = pe_manager[m_index].GetBiasAddr(pe_config.OutputIndex());
+          input_read_addrs[0] = InputHalfAddr(pe_manager[m_index].GetBiasAddr(pe_config.OutputIndex()), 0);
           input_read_req_valid[0] = 1;        
         }
         break;
@@ -399,7 +645,41 @@ class PECore : public match::Module {
     }
   }  
   
+  bool IsVectorZero(spec::VectorType vec) {
+    NVUINTW(spec::kVectorSize) is_scalar_zero;
+    #pragma hls_unroll yes
+    for (int i = 0; i < spec::kVectorSize; i++)
+      is_scalar_zero[i] = (vec[i] == 0);
+    bool is_vec_zero  = is_scalar_zero.and_reduce();
+    return is_vec_zero;
+  }
+  
+  // Zero skipping: count leading zero inputs of the current row within
+  // spec::PE::kZeroSkipWindow, is_nonzero if a non-zero input ends the run
+  void FindNonzeroInput(const NVUINT4 m_index, NVUINT8& num_skip, bool& is_nonzero) {
+    NVUINT8 num_remain = pe_manager[m_index].num_input - pe_config.InputIndex();
+    num_skip = 0;
+    is_nonzero = 0;
+    #pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::kZeroSkipWindow; i++) {
+      if (!is_nonzero && i < num_remain) {
+        spec::PE::Input::Address addr = 
+            InputHalfAddr(pe_manager[m_index].GetInputAddr(pe_config.InputIndex() + i), 0);
+        if (input_zero_flags[addr] == 1) {
+          num_skip += 1;
+        }
+        else {
+          is_nonzero = 1;
+        }
+      }
+    }
+  }
+  
   void BufferAccress() {
+    // keep input_zero_flags in sync with input SRAM contents
+    if (input_write_req_valid[0]) {
+      input_zero_flags[input_write_addrs[0]] = IsVectorZero(input_write_data[0]);
+    }
     weight_mem.run(
       weight_read_addrs          , 
       weight_read_req_valid      ,     
@@ -428,7 +708,10 @@ class PECore : public match::Module {
   }
 
   void RunMac() {
-    if (state == MAC) {
+    if (w_bias_fetch) {
+      row_bias = input_port_read_out[0];
+    }
+    if (state == MAC && !w_mac_skip) {
       NVUINT4   m_index = pe_config.ManagerIndex();
       
       spec::VectorType dp_in0[spec::kNumVectorLanes];
@@ -453,22 +736,41 @@ class PECore : public match::Module {
           dp_in0[i] = weight_port_read_out[i];
         }
       }
-      dp_in1 = input_port_read_out[0];
+      if (is_pipeline_run && pe_config.OutputIndex() != 0) {
+        dp_in1 = input_cache[m_index][pe_config.InputIndex()];
+      }
+      else {
+        dp_in1 = input_port_read_out[0];
+        if (is_pipeline_run) {
+          input_cache[m_index][pe_config.InputIndex()] = dp_in1;
+        }
+      }
       
       Datapath(dp_in0, dp_in1, dp_out);
       
       #pragma hls_unroll yes
       for (int i = 0; i < spec::kNumVectorLanes; i++) {
-        accum_vector[i] += dp_out[i];
+        accum_vector[0][i] += dp_out[i];
       }      
+      
+      // batch mode: the same weight block for the other batches
+      #pragma hls_unroll yes
+      for (unsigned b = 1; b < spec::PE::kMaxBatch; b++) {
+        if (b < pe_config.NumBatch()) {
+          spec::AccumVectorType dp_out_b;
+          Datapath(dp_in0, input_port_read_out[b], dp_out_b);
+          #pragma hls_unroll yes
+          for (int i = 0; i < spec::kNumVectorLanes; i++) {
+            accum_vector[b][i] += dp_out_b[i];
+          }
+        }
+      }
     }
   }
   
-  void RunBias() {         
-    if (state == BIAS) {
-      NVUINT4           m_index = pe_config.ManagerIndex();
-      
-      
+  // Shift, append bias and saturate a finished row into act format
+  void ComputeAct(const spec::AccumVectorType& accum_in, const spec::VectorType& bias_in,
+                  const NVUINT4 m_index, spec::ActVectorType& act_out) {
       // determine the shift amount
       // accum_vector fixed format num frac = -(2*spec::kAdpfloatOffset + adpbias_input + adpbias_weight - 2*spec::kAdpfloatManWidth) 
       //   i.e. = -(-18 + adpbias_input + adpbias_weight - 2*4) = 26 - (adpbias_input + adpbias_weight) >= 12, since bias range is 0~7 
@@ -483,13 +785,13 @@ class PECore : public match::Module {
       
       #pragma hls_unroll yes
       for (int i = 0; i < spec::kNumVectorLanes; i++) {
-        accum_vector_out[i] = accum_vector[i] >> right_shift;
+        accum_vector_out[i] = accum_in[i] >> right_shift;
 
         // Can skip appending bias if pe_config.is_bias == 0
         // MERGE BIAS bias_port -> input_port
         if (pe_config.is_bias) {
           AdpfloatType<spec::kAdpfloatWordWidth, spec::kAdpfloatExpWidth> 
-              adpfloat_tmp(input_port_read_out[0][i]);
+              adpfloat_tmp(bias_in[i]);
           spec::ActScalarType bias_tmp2 = 
               adpfloat_tmp.to_fixed<spec::kActWordWidth, spec::kActNumFrac>(pe_manager[m_index].adplfloat_bias_bias);
           accum_vector_out[i] += bias_tmp2;
@@ -501,15 +803,43 @@ class PECore : public match::Module {
         else if (accum_vector_out[i] < spec::kActWordMin) 
           accum_vector_out[i] = spec::kActWordMin;
         
-        act_port_reg[i] = accum_vector_out[i];   
+        act_out[i] = accum_vector_out[i];   
       }         
+  }
+  
+  void RunBias() {         
+    if (state == BIAS && !is_pipeline_run) {
+      NVUINT4           m_index = pe_config.ManagerIndex();
+      spec::ActVectorType act_tmp;
+      ComputeAct(accum_vector[0], input_port_read_out[0], m_index, act_tmp);
+      FuseAct(pe_config.IsFuseRow(), m_index, act_tmp, act_port_reg[0]);
       
+      // batch mode: same bias for every batch
+      #pragma hls_unroll yes
+      for (unsigned b = 1; b < spec::PE::kMaxBatch; b++) {
+        if (b < pe_config.NumBatch()) {
+          ComputeAct(accum_vector[b], input_port_read_out[0], m_index, act_port_reg[b]);
+        }
+      }
+    }
+  }
+
+  // pipelined mode: retire the row latched in the previous cycle
+  void RunRetire() {
+    if (retire_valid) {
+      spec::ActVectorType act_tmp;
+      ComputeAct(retire_accum, retire_bias, retire_m_index, act_tmp);
+      FuseAct(retire_fuse, retire_m_index, act_tmp, act_port_reg[0]);
+      if (!retire_hold) {
+        act_port.Push(act_port_reg[0]);
+      }
+      retire_valid = 0;
     }
   }
 
   void PushOutput() {
-    if (state == OUT) {
-      act_port.Push(act_port_reg);
+    if (state == OUT && !pe_config.IsFuseHold()) {
+      act_port.Push(act_port_reg[batch_counter]);
     }
   }
   
@@ -529,6 +859,54 @@ class PECore : public match::Module {
     
   }
   
+  // pipelined mode needs every manager's input vectors in input_cache
+  bool IsInputCacheFit() const {
+    bool is_fit = 1;
+    #pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::kNumPEManagers; i++) {
+      bool is_used = (i < pe_config.num_manager) || (pe_config.is_chain && i == spec::PE::kChainManager);
+      if (is_used && pe_manager[i].num_input > spec::PE::kNumInputCache) {
+        is_fit = 0;
+      }
+    }
+    return is_fit;
+  }
+
+  // pipelined mode: hand the finished row to RunRetire() of the next cycle
+  void LatchRetire(const spec::VectorType& bias_in) {
+    retire_accum   = accum_vector[0];
+    retire_bias    = bias_in;
+    retire_m_index = pe_config.ManagerIndex();
+    retire_fuse    = pe_config.IsFuseRow();
+    retire_hold    = pe_config.IsFuseHold();
+    retire_valid   = 1;
+    accum_vector[0] = 0;
+  }
+
+  // pipelined mode: move to next row without PRE/OUT
+  void NextPipelineRow(FSM& next_state) {
+    bool is_output_end = 0;
+    pe_config.UpdateManagerCounter(is_output_end);
+    if (is_output_end) {
+      next_state = DRAIN;
+    }
+    else {
+      NVUINT4 m_index = pe_config.ManagerIndex();
+      if (pe_manager[m_index].zero_active && pe_config.is_zero_first) {
+        // skip MAC
+        next_state = BIAS;
+      }
+      else {
+        next_state = MAC;
+      }
+    }
+  }
+
+  void UpdateCycleCounter() {
+    busy_cycles += 1;
+    state_cycles[state] += 1;
+  }
+
   // Update FSM State and PE_config counters
   void UpdateFSM() {
     FSM next_state;
@@ -536,6 +914,14 @@ class PECore : public match::Module {
       case IDLE: {
         if (is_start) {
           next_state = PRE;
+          chain_input_counter = 0;
+          is_pipeline_run = pe_config.is_pipeline && IsInputCacheFit() && (pe_config.NumBatch() == 1);
+          if (pe_config.IsInputDbuf()) {
+            #pragma hls_unroll yes
+            for (unsigned i = 0; i < spec::PE::kNumPEManagers; i++) {
+              pe_manager[i].SwapInputBank();
+            }
+          }
         }
         else { 
           next_state = IDLE;
@@ -558,9 +944,17 @@ class PECore : public match::Module {
       case MAC: {
         NVUINT4 m_index = pe_config.ManagerIndex();
         bool is_input_end= 0;
+        bool is_first_row = (pe_config.OutputIndex() == 0);
         pe_config.UpdateInputCounter(pe_manager[m_index].num_input, is_input_end);
         if (is_input_end) {
-          next_state = BIAS;
+          // first row of a manager needs a BIAS cycle (input port was busy)
+          if (is_pipeline_run && !(is_first_row && pe_config.is_bias)) {
+            LatchRetire(row_bias);
+            NextPipelineRow(next_state);
+          }
+          else {
+            next_state = BIAS;
+          }
         }
         else {
           next_state = MAC;
@@ -568,15 +962,42 @@ class PECore : public match::Module {
         break;  
       }
       case BIAS: {
-        next_state = OUT;
+        if (is_pipeline_run) {
+          LatchRetire(input_port_read_out[0]);
+          NextPipelineRow(next_state);
+        }
+        else {
+          next_state = OUT;
+        }
         break;
       }
       
+      case DRAIN: {
+        // last row retired in this cycle
+        if (pe_config.IsChainPhase()) {
+          next_state = WAIT;
+        }
+        else {
+          next_state = IDLE;
+          is_start = 0;
+          CDCOUT(sc_time_stamp()  << " PECore: " << name() << " Finish" << endl, kDebugLevel);
+        }
+        break;
+      }
       case OUT: {
+        // batch mode: one OUT cycle per batch
+        if (batch_counter != (pe_config.NumBatch() - 1)) {
+          batch_counter += 1;
+          next_state = OUT;
+          break;
+        }
         // Check end condition  
         bool is_output_end = 0;   
         pe_config.UpdateManagerCounter(is_output_end);
-        if (is_output_end) {
+        if (is_output_end && pe_config.IsChainPhase()) {
+          next_state = WAIT;
+        }
+        else if (is_output_end) {
           next_state = IDLE;
           is_start = 0;
           CDCOUT(sc_time_stamp()  << " PECore: " << name() << " Finish" << endl, kDebugLevel);
@@ -585,6 +1006,17 @@ class PECore : public match::Module {
           next_state = PRE;
           CDCOUT(sc_time_stamp()  << " PECore: " << name() << "next state = " << next_state << endl, kDebugLevel);
         }
+        break;
+      }
+      case WAIT: {
+        // chained pass starts after all feedback vectors are in input SRAM
+        if (chain_input_counter == pe_manager[spec::PE::kChainManager].num_input) {
+          next_state = PRE;
+        }
+        else {
+          next_state = WAIT;
+        }
+        break;
       }
       default: {
         next_state = IDLE; // Minor fix 02262019
@@ -600,14 +1032,21 @@ class PECore : public match::Module {
     while (1) {
       Initialize();
       RunFSM();
+      RecvFeedback();
+      RecvInput();
       if (is_start == 0) {
         DecodeAxi(); 
       }
+      else if (pe_config.is_pingpong) {
+        DecodeAxiPreload();
+      }
       BufferAccress(); 
       if (is_start == 1) {
         RunMac();
         RunBias();
+        RunRetire();
         PushOutput();
+        UpdateCycleCounter();
       }
       else {
         PushAxiRsp();
@@ -66,9 +66,13 @@ SC_MODULE(Source) {
         
  
   std::vector<spec::Axi::SlaveToRVA::Write> src_vec;
+  // PE start is pushed before src_vec[start_index], time each request is accepted
+  unsigned start_index;
+  std::vector<sc_time> push_time;
   
   
   SC_CTOR(Source) {
+    start_index = -1;
     SC_THREAD(run);
     sensitive << clk.pos();
     async_reset_signal_is(rst, false);
@@ -80,11 +84,16 @@ SC_MODULE(Source) {
     wait();
     //cout << "size of src_vec: " << src_vec.size() << endl;
     for (unsigned i = 0; i < src_vec.size(); i++) {
+      if (i == start_index) {
+        cout << sc_time_stamp() << " Source PE start" << endl;
+        start.Push(1);
+      }
       if (src_vec[i].rw == 1) {
         cout << hex << sc_time_stamp() << " Source rva write data " << src_vec[i].data << endl;
       }
     
       rva_in.Push(src_vec[i]);
+      push_time.push_back(sc_time_stamp());
       wait();
     }
   }
@@ -98,6 +107,9 @@ SC_MODULE(Dest) {
   std::vector<spec::Axi::SlaveToRVA::Read> dest_vec;
 
   spec::Axi::SlaveToRVA::Read rva_out_dest;
+  spec::ActVectorType act_port_dest;
+  unsigned act_count;
+  sc_time last_act_time;
 
   SC_CTOR(Dest) {
     SC_THREAD(run);
@@ -110,12 +122,17 @@ SC_MODULE(Dest) {
     wait();
     
     unsigned i = 0;
+    act_count = 0;
     while (1) {
       if (rva_out.PopNB(rva_out_dest)) {
         cout << hex << sc_time_stamp() << " Dest rva data = " << rva_out_dest.data << endl;
         assert(rva_out_dest.data == dest_vec[i].data);
         i++;
       }
+      if (act_port.PopNB(act_port_dest)) {
+        act_count++;
+        last_act_time = sc_time_stamp();
+      }
       wait();    
     }
   }
@@ -133,6 +150,7 @@ SC_MODULE(testbench) {
   Connections::Combinational<spec::Axi::SlaveToRVA::Write> rva_in;
   Connections::Combinational<spec::Axi::SlaveToRVA::Read> rva_out;
   Connections::Combinational<spec::ActVectorType> act_port;
+  Connections::Combinational<spec::StreamType> feedback_port;
   
 
 
@@ -140,6 +158,8 @@ SC_MODULE(testbench) {
   Source  source;
   Dest    dest;
   
+  unsigned preload_index;
+  
   testbench(sc_module_name name)
   : sc_module(name),
     clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
@@ -155,6 +175,7 @@ SC_MODULE(testbench) {
 		dut.rva_in(rva_in);
 		dut.rva_out(rva_out);		
 	  dut.act_port(act_port);
+    dut.feedback_port(feedback_port);
     
     source.clk(clk);
     source.rst(rst);
@@ -299,6 +320,84 @@ SC_MODULE(testbench) {
     rva_write_tmp.rw = 0;
     rva_write_tmp.addr = set_bytes<3>("40_00_50");
     source.src_vec.push_back(rva_write_tmp);
+
+    // PE config with ping-pong buffer (active_idx = 1, AXI goes to half 0) 
+    // and pipelined FSM, zero skipping, double buffered input stream
+    rva_write_tmp.rw = 1;
+    rva_write_tmp.data = set_bytes<16>("00_00_00_00_00_01_01_01_01_01_20_02_01_01_01_01");
+    rva_write_tmp.addr = set_bytes<3>("40_00_10");
+    rva_read_tmp.data = rva_write_tmp.data;
+    source.src_vec.push_back(rva_write_tmp);
+    dest.dest_vec.push_back(rva_read_tmp);
+
+    // Weight SRAM (shadow half)
+    rva_write_tmp.rw = 1;
+    rva_write_tmp.data = nvhls::get_rand<32>();
+    rva_write_tmp.addr = set_bytes<3>("50_00_20");
+    rva_read_tmp.data = rva_write_tmp.data;
+    source.src_vec.push_back(rva_write_tmp);
+    dest.dest_vec.push_back(rva_read_tmp);
+
+    rva_write_tmp.rw = 0;
+    rva_write_tmp.addr = set_bytes<3>("40_00_10");
+    source.src_vec.push_back(rva_write_tmp);
+
+    rva_write_tmp.rw = 0;
+    rva_write_tmp.addr = set_bytes<3>("50_00_20");
+    source.src_vec.push_back(rva_write_tmp);
+
+    // cycle counters (cleared, PE never started)
+    rva_write_tmp.rw = 1;
+    rva_write_tmp.data = 0;
+    rva_write_tmp.addr = set_bytes<3>("40_00_80");
+    source.src_vec.push_back(rva_write_tmp);
+
+    rva_write_tmp.rw = 0;
+    rva_write_tmp.addr = set_bytes<3>("40_00_80");
+    rva_read_tmp.data = 0;
+    source.src_vec.push_back(rva_write_tmp);
+    dest.dest_vec.push_back(rva_read_tmp);
+
+    rva_write_tmp.rw = 0;
+    rva_write_tmp.addr = set_bytes<3>("40_00_A0");
+    rva_read_tmp.data = 0;
+    source.src_vec.push_back(rva_write_tmp);
+    dest.dest_vec.push_back(rva_read_tmp);
+
+    // Start the PE (32 outputs x 2 managers, zero_first) and preload the
+    // shadow half while it runs, the config read is held until IDLE
+    // (is_zero_first is cleared by then)
+    source.start_index = source.src_vec.size();
+    preload_index = source.src_vec.size();
+    rva_write_tmp.rw = 1;
+    rva_write_tmp.data = nvhls::get_rand<32>();
+    rva_write_tmp.addr = set_bytes<3>("50_01_00");
+    rva_read_tmp.data = rva_write_tmp.data;
+    source.src_vec.push_back(rva_write_tmp);
+    spec::Axi::SlaveToRVA::Read weight_read_tmp = rva_read_tmp;
+
+    rva_write_tmp.rw = 1;
+    rva_write_tmp.data = nvhls::get_rand<32>();
+    rva_write_tmp.addr = set_bytes<3>("60_00_30");
+    rva_read_tmp.data = rva_write_tmp.data;
+    source.src_vec.push_back(rva_write_tmp);
+    spec::Axi::SlaveToRVA::Read input_read_tmp = rva_read_tmp;
+
+    rva_write_tmp.rw = 0;
+    rva_write_tmp.addr = set_bytes<3>("40_00_10");
+    rva_read_tmp.data = set_bytes<16>("00_00_00_00_00_01_01_01_01_01_20_02_01_01_00_01");
+    source.src_vec.push_back(rva_write_tmp);
+    dest.dest_vec.push_back(rva_read_tmp);
+
+    rva_write_tmp.rw = 0;
+    rva_write_tmp.addr = set_bytes<3>("50_01_00");
+    source.src_vec.push_back(rva_write_tmp);
+    dest.dest_vec.push_back(weight_read_tmp);
+
+    rva_write_tmp.rw = 0;
+    rva_write_tmp.addr = set_bytes<3>("60_00_30");
+    source.src_vec.push_back(rva_write_tmp);
+    dest.dest_vec.push_back(input_read_tmp);
   }
   
   
@@ -311,6 +410,9 @@ SC_MODULE(testbench) {
     rst.write(true);
     std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
     wait(10000, SC_NS );
+    // all rows pushed, preload writes accepted before the last one
+    assert(dest.act_count == 64);
+    assert(source.push_time[preload_index+1] < dest.last_act_time);
     std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
     sc_stop();
   }
@@ -183,6 +183,7 @@ class PEModule : public match::Module {
   Connections::Combinational<spec::Axi::SlaveToRVA::Write> act_rva_in;
   Connections::Combinational<spec::Axi::SlaveToRVA::Read> act_rva_out;
   Connections::Combinational<spec::ActVectorType> act_port;
+  Connections::Combinational<spec::StreamType> feedback_port;
 
   sc_signal<NVUINT32> SC_SRAM_CONFIG;
 
@@ -206,6 +207,7 @@ class PEModule : public match::Module {
         act_rva_in("act_rva_in"),
         act_rva_out("act_rva_out"),
         act_port("act_port"),
+        feedback_port("feedback_port"),
         SC_SRAM_CONFIG("SC_SRAM_CONFIG"),
         perva_inst("perva_inst"),
         pecore_inst("pecore_inst"),
@@ -227,6 +229,7 @@ class PEModule : public match::Module {
     pecore_inst.clk(clk);
     pecore_inst.rst(rst);
     pecore_inst.act_port(act_port);
+    pecore_inst.feedback_port(feedback_port);
     pecore_inst.input_port(input_port);
     pecore_inst.start(pe_start);
     pecore_inst.rva_in(pe_rva_in);
@@ -241,6 +244,7 @@ class PEModule : public match::Module {
     act_inst.rva_in(act_rva_in);
     act_inst.rva_out(act_rva_out);
     act_inst.output_port(output_port);
+    act_inst.feedback_port(feedback_port);
     act_inst.done(done);
   }
   
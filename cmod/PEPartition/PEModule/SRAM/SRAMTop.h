@@ -87,9 +87,12 @@ class SRAMTop : public match::Module {
   }
 
   void ResetBufferInputs() {
-    input_read_addrs          [0] = 0; 
-    input_read_req_valid      [0] = 0;  
-    input_read_ready          [0] = 0;  
+    #pragma hls_unroll yes 
+    for (unsigned i = 0; i < spec::PE::Input::kNumReadPorts; i++) { 
+      input_read_addrs          [i] = 0; 
+      input_read_req_valid      [i] = 0;  
+      input_read_ready          [i] = 0;  
+    }
     input_write_addrs         [0] = 0;
     input_write_req_valid     [0] = 0;
     input_write_data          [0] = 0;
@@ -118,17 +118,27 @@ SC_MODULE(Top){
   
 // Streaming and Control 
 // XXX Important: The done, start signals btw GB and PEs have much less delay than streaming data communication.
-//                this means that race problem will occur if there is no explicit delay logics on done, start signals
-//                The delay of done, start signals is implemented in pe_done_inst, pe_start_inst, we can use spec::kGlobalTriggerDelay 
-//                to configure the delay cycles 
+//                this means that race problem will occur if start/done overtake the data streamed before them.
+//                start/done go through gb_send_inst (gb_recv_inst), which pass them on to pe_start_inst (pe_done_inst)
+//                only after the inputs (outputs) streamed before them have been delivered 
   // GB sends gb_done which triggers IRQ
   Connections::Combinational<bool>              gb_done;
-  // GB sends all_pe_start which is handled by pe_start_inst to activate all PEs
-  Connections::Combinational<bool>              all_pe_start;
+  // GB sends all_pe_start which is handled by gb_send_inst and pe_start_inst to activate all PEs (of a PE group)
+  Connections::Combinational<bool>              all_pe_start[spec::kNumPEGroups];
+  Connections::Combinational<bool>              pe_start_sent[spec::kNumPE];   // gb_send_inst -> pe_start_inst
   Connections::Combinational<bool>              pe_start_array[spec::kNumPE];  
-  // Each PE sends done signal handled by pe_done_inst, the all_pe_done is send to GB when all PE are done
+  // Each PE sends done signal handled by gb_recv_inst and pe_done_inst, the all_pe_done is send to GB when all PE (of a PE group) are done
   Connections::Combinational<bool>              pe_done_array[spec::kNumPE];
-  Connections::Combinational<bool>              all_pe_done;
+  Connections::Combinational<bool>              pe_done_recv[spec::kNumPE];    // gb_recv_inst -> pe_done_inst
+  Connections::Combinational<bool>              all_pe_done[spec::kNumPEGroups];
+  // Layer pipelining: PE group of each PE, written by GB (0x4 local 0x06)
+  sc_signal<spec::PEMaskType>                   pe_group;
+  // Per-PE completion: pe_done_inst -> pe_start_inst (early start of idle PEs), pe_done_inst -> GB,
+  //   pe_start_inst -> pe_done_inst (only the dones of started PEs are counted)
+  sc_signal<spec::PEMaskType>                   pe_start_toggle;
+  sc_signal<spec::PEMaskType>                   pe_done_toggle;
+  sc_signal<spec::PEMaskType>                   pe_done_status;
+  sc_signal<spec::PEMaskType>                   pe_done_overflow;   // PE done lost by pe_done_inst (sticky)
   // GB broadcast activations to PEs by gb_send_inst
   Connections::Combinational<spec::StreamType>  gb_output;   
   Connections::Combinational<spec::StreamType>  pe_inputs[spec::kNumPE];
@@ -195,8 +205,12 @@ SC_MODULE(Top){
     gb_inst.if_axi_wr.b (axi_wr_c_b[0]);  
     gb_inst.data_in(data_out);       
     gb_inst.data_out(gb_output);
-    gb_inst.pe_start(all_pe_start);
-    gb_inst.pe_done(all_pe_done);
+    gb_inst.pe_start(all_pe_start[0]);
+    gb_inst.pe_done(all_pe_done[0]);
+    gb_inst.pe_start_1(all_pe_start[1]);
+    gb_inst.pe_done_1(all_pe_done[1]);
+    gb_inst.pe_group(pe_group);
+    gb_inst.pe_done_status(pe_done_status);
 
 // Instantiation of PEs (no unroll needed)
     for (int i = 0; i < spec::kNumPE; i++) {    
@@ -235,31 +249,48 @@ SC_MODULE(Top){
 // Databus Modules
     pe_start_inst.clk(clk);
     pe_start_inst.rst(rst);
-    pe_start_inst.all_pe_start(all_pe_start);
+    pe_start_inst.pe_done_toggle(pe_done_toggle);
+    pe_start_inst.pe_start_toggle(pe_start_toggle);
     for (int i = 0; i < spec::kNumPE; i++) {     
+      pe_start_inst.pe_start_in[i](pe_start_sent[i]);
       pe_start_inst.pe_start_array[i](pe_start_array[i]);
     }
     
     pe_done_inst.clk(clk);
     pe_done_inst.rst(rst);
     for (int i = 0; i < spec::kNumPE; i++) {     
-      pe_done_inst.pe_done_array[i](pe_done_array[i]);
+      pe_done_inst.pe_done_array[i](pe_done_recv[i]);
+    }
+    pe_done_inst.pe_group(pe_group);
+    pe_done_inst.pe_start_toggle(pe_start_toggle);
+    pe_done_inst.pe_done_toggle(pe_done_toggle);
+    pe_done_inst.pe_done_status(pe_done_status);
+    pe_done_inst.pe_done_overflow(pe_done_overflow);
+    for (int g = 0; g < spec::kNumPEGroups; g++) {     
+      pe_done_inst.all_pe_done[g](all_pe_done[g]);
     }
-    pe_done_inst.all_pe_done(all_pe_done);
     
     gb_send_inst.clk(clk);
     gb_send_inst.rst(rst);
     gb_send_inst.gb_output(gb_output);
+    gb_send_inst.pe_group(pe_group);
+    for (int g = 0; g < spec::kNumPEGroups; g++) {     
+      gb_send_inst.all_pe_start[g](all_pe_start[g]);
+    }
     for (int i = 0; i < spec::kNumPE; i++) {     
       gb_send_inst.pe_inputs[i](pe_inputs[i]);
+      gb_send_inst.pe_start_out[i](pe_start_sent[i]);
     }  
     
     gb_recv_inst.clk(clk);
     gb_recv_inst.rst(rst);
     for (int i = 0; i < spec::kNumPE; i++) {     
       gb_recv_inst.data_in[i](data_in[i]);
+      gb_recv_inst.pe_done_in[i](pe_done_array[i]);
+      gb_recv_inst.pe_done_out[i](pe_done_recv[i]);
     }  
     gb_recv_inst.data_out[0](data_out);
+    gb_recv_inst.pe_group(pe_group);
 // Interrupt Module
     irq_inst.clk(clk);
     irq_inst.rst(rst);
@@ -86,12 +86,24 @@ SC_MODULE(Dest) {
 
 
   void PopInterrupt() {
+   // cycle count between interrupts (benchmark of back-to-back launches)
+   unsigned long cycle = 0, last_cycle = 0;
+   unsigned num_interrupt = 0;
+   bool last_interrupt = 0;
    wait();
  
    while (1) {
+     cycle++;
      if (interrupt == 1) {
         cout << sc_time_stamp() << " - Interrupt signal issued!" << endl;
+        if (last_interrupt == 0) {
+          num_interrupt++;
+          cout << dec << "Interrupt " << num_interrupt << ": " << cycle << " cycles after reset, "
+               << (cycle - last_cycle) << " cycles since last interrupt" << endl;
+          last_cycle = cycle;
+        }
      }
+     last_interrupt = interrupt.read();
      wait(); 
    } // while
    
@@ -119,9 +131,9 @@ SC_MODULE(testbench) {
   typename axi::axi4<spec::Axi::axiCfg>::write::template chan<> axi_write;
 
   
-  testbench(sc_module_name name)
+  testbench(sc_module_name name, const char* cmd_file)
   : sc_module(name),
-     master("master", "axi_commands_for_kmeans_clustering_for_LSTM_4_timesteps_zero_first_enabled_4PEs.csv"),
+     master("master", cmd_file),
      clk("clk", 1.0, SC_NS, 0.5, 0, SC_NS, true),
      rst("rst"),
      dut("dut"),
@@ -180,7 +192,12 @@ int sc_main(int argc, char *argv[]) {
   NVINT8 test = 14;
   cout << fixed2float<8, 3>(test) << endl;  
 
-  testbench tb("tb");
+  // optional AXI command file (make run CMD_FILE=...), the interrupt cycles are printed
+  const char* cmd_file = "axi_commands_for_kmeans_clustering_for_LSTM_4_timesteps_zero_first_enabled_4PEs.csv";
+  if (argc > 1) {
+    cmd_file = argv[1];
+  }
+  testbench tb("tb", cmd_file);
   
   sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
   sc_start();
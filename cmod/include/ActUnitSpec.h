@@ -55,7 +55,8 @@ namespace spec {
   2: STORE: use output counter to locate (from A2)
   3: INPE:  wait data from PE and store  (to A2)
   4: OUTGB: Output to output port        (to A2)
-  
+  5: OUTPE: Output to PECore input SRAM   (from A2, PEConfig.is_chain)
+  6: ESUB: A2-A1 => A2 (GRU: h' = n + z*(h-n))
   7: COPY: A1 -> A2
   8: EADD: A2+A1 => A2
   9: EMUL: A2*A1 => A2
@@ -79,11 +80,17 @@ class ActConfig {
   NVUINT8                 num_output; // maximum is much larger than the required
   spec::Act::Address      buffer_addr_base;
   NVUINT8                 output_addr_base;
+  // second program for the chained PE pass (PEConfig.is_chain), 
+  //   runs after the first one if num_output_chain != 0
+  NVUINT6                 num_inst_chain;
+  NVUINT8                 num_output_chain;
+  NVUINT5                 inst_base_chain;  // first instruction of the second program
   
   NVUINT8                 inst_regs[spec::Act::kNumInstEntries];
   // internal state 
   NVUINT5   inst_counter;
   NVUINT8   output_counter;
+  NVUINT1   chain_phase;
   
   
   ActConfig() {  
@@ -91,17 +98,29 @@ class ActConfig {
   }
   
   NVUINT8 InstFetch(){
+    if (chain_phase) {
+      NVUINT5 inst_index = inst_counter + inst_base_chain;
+      return inst_regs[inst_index];
+    }
     return inst_regs[inst_counter];
   }
   
   bool InstIncr() {
     bool is_end = 0;
-    if (inst_counter == (num_inst-1)) {
+    NVUINT6 num_inst_curr = chain_phase ? num_inst_chain : num_inst;
+    NVUINT8 num_output_curr = chain_phase ? num_output_chain : num_output;
+    if (inst_counter == (num_inst_curr-1)) {
       inst_counter = 0;
-      if (output_counter == (num_output-1)) {    
+      if (output_counter == (num_output_curr-1)) {    
         output_counter = 0;
         is_zero_first = 0; // disactivate is_zero_first
-        is_end = 1;
+        if (!chain_phase && num_output_chain != 0) {
+          chain_phase = 1;
+        }
+        else {
+          chain_phase = 0;
+          is_end = 1;
+        }
       }
       else {
         output_counter += 1;
@@ -122,11 +141,14 @@ class ActConfig {
     num_output      = 1;    // should be initialize to 1 to avoid error
     buffer_addr_base = 0;
     output_addr_base = 0;
-
+    num_inst_chain  = 1;    // should be initialize to 1 to avoid error
+    num_output_chain = 0;
+    inst_base_chain = 0;
   }
   void ResetCounter(){
     inst_counter    = 0;
     output_counter  = 0;  
+    chain_phase     = 0;
   }
   
   
@@ -140,7 +162,9 @@ class ActConfig {
       num_output            = nvhls::get_slc<8>(write_data, 32);
       buffer_addr_base      = nvhls::get_slc<spec::Act::kAddressWidth>(write_data, 48);
       output_addr_base      = nvhls::get_slc<8>(write_data, 64);
-      
+      num_inst_chain        = nvhls::get_slc<6>(write_data, 72);
+      num_output_chain      = nvhls::get_slc<8>(write_data, 80);
+      inst_base_chain       = nvhls::get_slc<5>(write_data, 88);
     }
     else if (write_index == 0x02) { // first 16 instructions
       #pragma hls_unroll yes
@@ -166,7 +190,9 @@ class ActConfig {
       read_data.set_slc<8>(32, num_output);
       read_data.set_slc<spec::Act::kAddressWidth>(48, buffer_addr_base);
       read_data.set_slc<8>(64, output_addr_base);
-      
+      read_data.set_slc<6>(72, num_inst_chain);
+      read_data.set_slc<8>(80, num_output_chain);
+      read_data.set_slc<5>(88, inst_base_chain);
     }
     else if (read_index == 0x02) { // first 16 instructions
       #pragma hls_unroll yes
@@ -47,6 +47,8 @@ namespace spec {
       typedef NVUINTW(kLocalIndexSize) LocalIndex;
 
       const int kMaxNumManagers = 4;
+      // Valid length of each region, 16 bits per region (GBCore 0x4 local 0x05)
+      typedef NVUINTW(16*kMaxNumManagers) ValidLengthType;
       // Parameters for COnfiguration 
       // const unsigned int kNumInstEntries = 16;
       class DataReq : public nvhls_message{
@@ -55,15 +57,17 @@ namespace spec {
         NVUINT2     memory_index;
         NVUINT8     vector_index;        
         NVUINT16    timestep_index;
+        NVUINT2     pool_shift;         // LayerReduce read: 1 << pool_shift timesteps
         WordType    write_data;        
         
-        static const unsigned int width = 1 + 2 + 8 + 16 + WordType::width;
+        static const unsigned int width = 1 + 2 + 8 + 16 + 2 + WordType::width;
         template <unsigned int Size>
         void Marshall(Marshaller<Size>& m) {
           m & is_write;
           m & memory_index;
           m & timestep_index;
           m & vector_index;        
+          m & pool_shift;
           m & write_data;
         }
         DataReq() {
@@ -74,6 +78,7 @@ namespace spec {
           memory_index = 0;
           timestep_index = 0;
           vector_index = 0;
+          pool_shift = 0;
           write_data = 0;
         }
       };     
@@ -102,9 +107,9 @@ namespace spec {
     namespace Small {
       typedef VectorType WordType;
       const unsigned int kNumWritePorts = 1;         
-      const unsigned int kNumReadPorts = 1;        
-      const unsigned int kNumBanks = 1;         
-      const unsigned int kEntriesPerBank = 1024;   // 16KB, we might need to store multiple set of results    
+      const unsigned int kNumReadPorts = 2;        
+      const unsigned int kNumBanks = 4;            // each bank holds one 256-entry quarter of the address space
+      const unsigned int kEntriesPerBank = 256;    // 16KB, we might need to store multiple set of results    
       const unsigned int kAddressWidth = nvhls::index_width<kNumBanks * kEntriesPerBank>::val;
       const unsigned int kBankIndexSize = nvhls::index_width<kNumBanks>::val;
       const unsigned int kLocalIndexSize = nvhls::index_width<kEntriesPerBank>::val;
@@ -121,14 +126,20 @@ namespace spec {
         NVUINT3     memory_index;
         NVUINT8     vector_index;        
         WordType    write_data;        
+        NVUINT1     is_dual;            // 1: second read returned in read_data_2
+        NVUINT3     memory_index_2;
+        NVUINT8     vector_index_2;
         
-        static const unsigned int width = 1 + 3 + 8 + WordType::width;
+        static const unsigned int width = 1 + 3 + 8 + WordType::width + 1 + 3 + 8;
         template <unsigned int Size>
         void Marshall(Marshaller<Size>& m) {
           m & is_write;
           m & memory_index;
           m & vector_index;        
           m & write_data;
+          m & is_dual;
+          m & memory_index_2;
+          m & vector_index_2;
         }
         DataReq() {
           Reset();
@@ -138,23 +149,29 @@ namespace spec {
           memory_index = 0;
           vector_index = 0;
           write_data = 0;
+          is_dual = 0;
+          memory_index_2 = 0;
+          vector_index_2 = 0;
         }
       };     
      
       class DataRsp : public nvhls_message {
        public:
         WordType read_data;
+        WordType read_data_2;
         
-        static const unsigned int width = WordType::width;
+        static const unsigned int width = 2*WordType::width;
         template <unsigned int Size>
         void Marshall(Marshaller<Size>& m) {
           m & read_data;
+          m & read_data_2;
         }
         DataRsp() {
           Reset();
         }
         void Reset() {
           read_data = 0;
+          read_data_2 = 0;
         }
       };
     }
@@ -164,11 +181,33 @@ namespace spec {
 class GBControlConfig {
   static const int write_width = 128;
  public: 
+  static const int kMaxNumHead = 8;
+  // Attention softmax scratch (small buffer memory 7), entries addressed by the 8-bit vector_index
+  static const int kNumScoreEntries = 256;
   NVUINT1   is_valid;
   // Control      0: Unidirectional, 1: bi-forward, 2: bi-backward, 3: Decoder
+  //              (1 and 2 run concurrently on the two PE groups with the joint start, GB start local 0x7)
   // LayerReduce  0: MaxPool, 1:MeanPool, 2: LayerAdd
   NVUINT3   mode;         
   NVUINT1   is_rnn;     // used to send collected RNN output back
+  NVUINT1   is_loopback;  // GBControl RNN: forward PE output (h) to PE while writing it to GB
+  NVUINT1   is_prefetch;  // GBControl: stream x(t+1) to PE during RECV of timestep t
+  NVUINT1   is_online_softmax;  // Attention: running max/sum while BMM1 produces scores
+  NVUINT1   is_tiled;     // Attention: encoder memory processed in tiles of num_tile_timestep
+  NVUINT16  num_tile_timestep;  // Attention: tile length in use (see SetTileTimestep)
+  NVUINT16  num_tile_timestep_write; // Attention: num_tile_timestep as written
+  NVUINT1   is_window;    // Attention: local attention over [window_start, window_start+window_width)
+  NVUINT16  window_start;
+  NVUINT16  window_width;
+  NVUINT4   num_head;     // Attention: number of heads, num_vector_1 split evenly (see SetNumHead)
+  NVUINT4   num_head_write; // Attention: num_head as written
+  NVUINT1   is_residual;  // LayerNorm: normalize memory_index_1 + memory_index_2 (residual add)
+  NVUINT4   num_pool;     // LayerReduce: timesteps reduced into one, 2, 4 or 8
+  NVUINT1   is_follow;    // GBControl: timestep t waits until the GBControl of the other PE group 
+                          //   finished timestep t (layer pipelining, its memory_index_2 is our input)
+  NVUINT1   is_eager;     // GBControl: with is_prefetch and !is_rnn, PEs done with timestep t start t+1 
+                          //   without waiting for the slowest PE
+  spec::PEMaskType pe_mask; // GBControl: PEs the stream is sent to, 0: all PEs of the group
   NVUINT3   memory_index_1; 
   NVUINT3   memory_index_2;
   NVUINT8   num_vector_1;
@@ -181,6 +220,12 @@ class GBControlConfig {
   spec::AdpfloatBiasType adpbias_4;
       
   
+  // Valid timesteps of each large buffer region (GBCore 0x4 local 0x05, sampled at start)
+  //   0: whole region, timesteps past it read as zero and are skipped by the loops
+  NVUINT16  valid_length[spec::GB::Large::kMaxNumManagers];
+  // Timestep loop bound of the current run, num_timestep_1 unless SetTimestepBound
+  NVUINT16  num_timestep_bound;
+  
   NVUINT8   vector_counter;
   NVUINT16  timestep_counter;
   
@@ -188,6 +233,22 @@ class GBControlConfig {
     is_valid        = 0;
     mode            = 0;    
     is_rnn          = 0;
+    is_loopback     = 0;
+    is_prefetch     = 0;
+    is_online_softmax = 0;
+    is_tiled        = 0;
+    num_tile_timestep = 256;
+    num_tile_timestep_write = 256;
+    is_window       = 0;
+    window_start    = 0;
+    window_width    = 16;
+    num_head        = 1;
+    num_head_write  = 1;
+    is_residual     = 0;
+    num_pool        = 2;
+    is_follow       = 0;
+    is_eager        = 0;
+    pe_mask         = 0;
     memory_index_1  = 0;
     memory_index_2  = 0;
     num_vector_1    = 1;
@@ -198,6 +259,11 @@ class GBControlConfig {
     adpbias_2   = 0;
     adpbias_3   = 0;
     adpbias_4   = 0;
+    num_timestep_bound = 1;
+    #pragma hls_unroll yes
+    for (int i = 0; i < spec::GB::Large::kMaxNumManagers; i++) {
+      valid_length[i] = 0;
+    }
     
     ResetCounter();
   }
@@ -207,17 +273,38 @@ class GBControlConfig {
       is_valid      = nvhls::get_slc<1>(write_data, 0);    
       mode          = nvhls::get_slc<3>(write_data, 8);
       is_rnn        = nvhls::get_slc<1>(write_data, 16);
+      is_loopback   = nvhls::get_slc<1>(write_data, 24);
       memory_index_1  = nvhls::get_slc<3>(write_data, 32);
       memory_index_2  = nvhls::get_slc<3>(write_data, 40);
       num_vector_1    = nvhls::get_slc<8>(write_data, 48);
       num_vector_2    = nvhls::get_slc<8>(write_data, 56);
       num_timestep_1  = nvhls::get_slc<16>(write_data, 64);    
+      num_timestep_bound = num_timestep_1;
       num_timestep_2  = nvhls::get_slc<16>(write_data, 80); 
                    
       adpbias_1       = nvhls::get_slc<spec::kAdpfloatBiasWidth>(write_data, 96);  
       adpbias_2       = nvhls::get_slc<spec::kAdpfloatBiasWidth>(write_data, 104);              
       adpbias_3       = nvhls::get_slc<spec::kAdpfloatBiasWidth>(write_data, 112);        
       adpbias_4       = nvhls::get_slc<spec::kAdpfloatBiasWidth>(write_data, 120);        
+      SetNumHead();
+      SetTileTimestep();
+    }
+    else if (write_index == 0x02) {
+      is_prefetch     = nvhls::get_slc<1>(write_data, 0);
+      is_online_softmax = nvhls::get_slc<1>(write_data, 8);
+      is_tiled        = nvhls::get_slc<1>(write_data, 16);
+      is_window       = nvhls::get_slc<1>(write_data, 24);
+      window_start    = nvhls::get_slc<16>(write_data, 32);
+      window_width    = nvhls::get_slc<16>(write_data, 48);
+      num_tile_timestep_write = nvhls::get_slc<16>(write_data, 64);
+      num_head_write  = nvhls::get_slc<4>(write_data, 80);
+      SetNumHead();
+      SetTileTimestep();
+      is_residual     = nvhls::get_slc<1>(write_data, 88);
+      num_pool        = nvhls::get_slc<4>(write_data, 96);
+      is_follow       = nvhls::get_slc<1>(write_data, 104);
+      is_eager        = nvhls::get_slc<1>(write_data, 108);
+      pe_mask         = nvhls::get_slc<spec::kNumPE>(write_data, 112);
     }
   }
 
@@ -227,6 +314,7 @@ class GBControlConfig {
       read_data.set_slc<1>(0, is_valid);
       read_data.set_slc<3>(8, mode);
       read_data.set_slc<1>(16, is_rnn);
+      read_data.set_slc<1>(24, is_loopback);
       read_data.set_slc<3>(32, memory_index_1);
       read_data.set_slc<3>(40, memory_index_2);
       read_data.set_slc<8>(48, num_vector_1);
@@ -239,10 +327,90 @@ class GBControlConfig {
       read_data.set_slc<spec::kAdpfloatBiasWidth>(112, adpbias_3);      
       read_data.set_slc<spec::kAdpfloatBiasWidth>(120, adpbias_4);      
     }
+    else if (read_index == 0x02) {
+      read_data.set_slc<1>(0, is_prefetch);
+      read_data.set_slc<1>(8, is_online_softmax);
+      read_data.set_slc<1>(16, is_tiled);
+      read_data.set_slc<1>(24, is_window);
+      read_data.set_slc<16>(32, window_start);
+      read_data.set_slc<16>(48, window_width);
+      read_data.set_slc<16>(64, num_tile_timestep);
+      read_data.set_slc<4>(80, num_head);
+      read_data.set_slc<1>(88, is_residual);
+      read_data.set_slc<4>(96, num_pool);
+      read_data.set_slc<1>(104, is_follow);
+      read_data.set_slc<1>(108, is_eager);
+      read_data.set_slc<spec::kNumPE>(112, pe_mask);
+    }
   }
 
 
   
+  // Softmax scratch entries of one Attention head: scores (4 per entry) of the whole range 
+  //   (at most num_timestep_1), or in tiled mode scores of one tile of tile_timestep plus 
+  //   the softmax output (16 per entry) of the whole range
+  NVUINT16 ScoreEntries(const NVUINT16 tile_timestep) const {
+    NVUINT16 num_block = (NVUINTW(17)(num_timestep_1) + 15) >> 4;
+    if (is_tiled) {
+      return (tile_timestep >> 2) + num_block;
+    }
+    return num_block << 2;
+  }
+  
+  // The largest head count up to the written one (at most kMaxNumHead) that splits 
+  //   num_vector_1 evenly and whose scratch entries (shortest tile in tiled mode) fit 
+  //   kNumScoreEntries, 1 if none does; re-evaluated on both config writes so the 
+  //   write order does not matter, and read back at local 0x02
+  void SetNumHead() {
+    NVUINT4 num_head_tmp = 1;
+    NVUINT16 num_entries = ScoreEntries(16);
+    #pragma hls_unroll yes
+    for (int i = 2; i <= kMaxNumHead; i++) {
+      if ((i <= num_head_write) && ((num_vector_1 % i) == 0) && 
+          ((i*num_entries) <= kNumScoreEntries)) {
+        num_head_tmp = i;
+      }
+    }
+    num_head = num_head_tmp;
+  }
+  
+  // Tiled mode: the written tile length, shortened (multiple of 16, at least 16) so that 
+  //   the scratch entries of all heads fit kNumScoreEntries; a range over 
+  //   (kNumScoreEntries-4)*16 timesteps does not fit tiled mode at all.
+  //   Evaluated after SetNumHead on both config writes, read back at local 0x02
+  void SetTileTimestep() {
+    NVUINT16 num_block = (NVUINTW(17)(num_timestep_1) + 15) >> 4;
+    NVUINT16 num_share = kNumScoreEntries / num_head;
+    NVUINT16 tile_max = 16;
+    if (num_share >= (num_block + 4)) {
+      tile_max = ((num_share - num_block) << 2) & 0xFFF0;
+    }
+    if (is_tiled && (num_tile_timestep_write > tile_max)) {
+      num_tile_timestep = tile_max;
+    }
+    else {
+      num_tile_timestep = num_tile_timestep_write;
+    }
+  }
+  
+  void ValidLengthWrite(const spec::GB::Large::ValidLengthType& write_data) {
+    #pragma hls_unroll yes
+    for (int i = 0; i < spec::GB::Large::kMaxNumManagers; i++) {
+      valid_length[i] = nvhls::get_slc<16>(write_data, 16*i);
+    }
+  }
+  
+  // Bound the timestep loops by the valid length of the region
+  void SetTimestepBound(const NVUINT3 memory_index) {
+    NVUINT16 length = valid_length[nvhls::get_slc<2>(memory_index, 0)];
+    if ((length == 0) || (length > num_timestep_1)) {
+      num_timestep_bound = num_timestep_1;
+    }
+    else {
+      num_timestep_bound = length;
+    }
+  }
+
   void ResetCounter() {
     vector_counter      = 0;
     timestep_counter    = 0;  
@@ -255,16 +423,20 @@ class GBControlConfig {
     return timestep_counter;
   }
   NVUINT16 GetTimestepIndexGBControl() const {
+    return GetTimestepIndexGBControl(timestep_counter);
+  }
+  // GBControl prefetch needs the index of the following timestep
+  NVUINT16 GetTimestepIndexGBControl(const NVUINT16 counter) const {
     NVUINT16 out; 
     switch (mode) {
     case 0: // Unidirectional 
-      out = timestep_counter;
+      out = counter;
       break;
     case 1: // Bi-forward 
-      out = timestep_counter << 1;
+      out = counter << 1;
       break;
     case 2: // Bi-backward
-      out = (num_timestep_1 - timestep_counter)*2 - 1;  
+      out = (num_timestep_1 - counter)*2 - 1;  
       break;
     default: // Decoder does not need timestep
       out = 0;
@@ -310,7 +482,7 @@ class GBControlConfig {
   
   void UpdateTimestepCounter(bool& is_end) {
     is_end = 0;
-    if (timestep_counter >= (num_timestep_1 - 1)) {
+    if (timestep_counter >= (num_timestep_bound - 1)) {
       is_end = 1;
       timestep_counter = 0;
     }
@@ -321,7 +493,7 @@ class GBControlConfig {
     
   void UpdateTimestepCounterByTwo(bool& is_end) {
     is_end = 0;
-    if (timestep_counter >= (num_timestep_1 - 2)) {
+    if (timestep_counter >= (num_timestep_bound - 2)) {
       is_end = 1;
       timestep_counter = 0;
     }
@@ -330,9 +502,20 @@ class GBControlConfig {
     }
   } 
   
+  void UpdateTimestepCounterBy(const NVUINT4 step, bool& is_end) {
+    is_end = 0;
+    if (timestep_counter >= (num_timestep_bound - step)) {
+      is_end = 1;
+      timestep_counter = 0;
+    }
+    else {
+      timestep_counter += step;
+    }
+  } 
+  
   void UpdateTimestepCounterBySixteen(bool& is_end) {
     is_end = 0;
-    if (timestep_counter >= (num_timestep_1 - 16)) {
+    if (timestep_counter >= (num_timestep_bound - 16)) {
       is_end = 1;
       timestep_counter = 0;
     }
@@ -356,4 +539,93 @@ class GBControlConfig {
   
   
 };
+
+// GBCore arbitration of the streaming requesters of one buffer
+//   mode 0: fixed priority (requester 0 first)
+//   mode 1: round-robin, priority starts after the last served requester
+//   mode 2: fixed priority, requesters waiting >= threshold cycles go first
+//   wait counters report the longest wait (cycles) seen since the last config write
+template<unsigned N>
+class GBArbiter {
+  static const int write_width = 128;
+ public:
+  NVUINT2   mode;
+  NVUINT8   threshold;
+  NVUINT3   rr_ptr;
+  NVUINT16  wait_cycles[N];
+  NVUINT16  max_wait[N];
+  
+  void Reset() {
+    mode      = 0;
+    threshold = 16;
+    ResetCounter();
+  }
+  
+  void ResetCounter() {
+    rr_ptr    = 0;
+    #pragma hls_unroll yes
+    for (unsigned i = 0; i < N; i++) {
+      wait_cycles[i] = 0;
+      max_wait[i]    = 0;
+    }
+  }
+  
+  void ConfigWrite(const NVUINTW(write_width)& write_data) {
+    mode      = nvhls::get_slc<2>(write_data, 0);
+    threshold = nvhls::get_slc<8>(write_data, 8);
+    ResetCounter();
+  }
+  
+  void ConfigRead(NVUINTW(write_width)& read_data) const {
+    read_data = 0;
+    read_data.set_slc<2>(0, mode);
+    read_data.set_slc<8>(8, threshold);
+    #pragma hls_unroll yes
+    for (unsigned i = 0; i < N; i++) {
+      read_data.set_slc<16>(32+16*i, max_wait[i]);
+    }
+  }
+  
+  // High priority requesters are served before the others, 
+  //   both groups in fixed order 
+  void GetPriority(bool is_high[N]) const {
+    #pragma hls_unroll yes
+    for (unsigned i = 0; i < N; i++) {
+      switch (mode) {
+        case 1: 
+          is_high[i] = (i >= rr_ptr);
+          break;
+        case 2: 
+          is_high[i] = (wait_cycles[i] >= threshold);
+          break;
+        default:
+          is_high[i] = 0;
+          break;
+      }
+    }
+  }
+  
+  void Update(const bool valid[N], const bool grant[N], const bool is_high[N]) {
+    bool is_grant = 0, is_grant_high = 0;
+    NVUINT3 first_grant = 0, first_grant_high = 0;
+    #pragma hls_unroll yes
+    for (unsigned i = 0; i < N; i++) {
+      if (grant[i]) {
+        wait_cycles[i] = 0;
+        if (!is_grant) first_grant = i;
+        if (!is_grant_high && is_high[i]) first_grant_high = i;
+        is_grant = 1;
+        is_grant_high = is_grant_high || is_high[i];
+      }
+      else if (valid[i]) {
+        if (wait_cycles[i] != 0xFFFF) wait_cycles[i] += 1;
+        if (wait_cycles[i] > max_wait[i]) max_wait[i] = wait_cycles[i];
+      }
+    }
+    if (is_grant) {
+      NVUINT3 last = is_grant_high ? first_grant_high : first_grant;
+      rr_ptr = (last == N - 1) ? 0 : last + 1;
+    }
+  }
+};
 #endif
@@ -26,6 +26,11 @@
 #include "AxiSpec.h"
 #include "AdpfloatSpec.h"
 
+// PE_BATCH (make PE_BATCH=1): input SRAM as 4 banks with 4 read ports for batch
+//   mode (PEConfig.num_batch up to 4), 4x the input SRAM read ports and the
+//   crossbar of ArbitratedScratchpadDP for the same 256 entries, default is the
+//   single bank, single read port input SRAM without batch mode
+
 namespace spec {
   namespace PE {
     namespace Weight {  
@@ -60,10 +65,17 @@ namespace spec {
     
     namespace Input {
       typedef VectorType WordType;
+#ifdef PE_BATCH
+      const int kNumReadPorts = 4; // batch mode reads up to 4 consecutive entries per cycle
+      const int kNumWritePorts = 1;
+      const int kNumBanks = 4;
+      const int kEntriesPerBank = 64;      // need to configure
+#else
       const int kNumReadPorts = 1; // spec::kNumVectorLanes
       const int kNumWritePorts = 1;
       const int kNumBanks = 1;
       const int kEntriesPerBank = 256;     // need to configure
+#endif
       const unsigned int kAddressWidth = nvhls::index_width<kNumBanks * kEntriesPerBank>::val;
       const unsigned int kBankIndexSize = nvhls::index_width<kNumBanks>::val;
       const unsigned int kLocalIndexSize = nvhls::index_width<kEntriesPerBank>::val;
@@ -73,7 +85,17 @@ namespace spec {
       typedef NVUINTW(kLocalIndexSize) LocalIndex;
     }
     
-    const unsigned int kNumPEManagers = 2;
+    const unsigned int kNumPEManagers = 3;
+    // manager of the chained second matrix-vector mul (PEConfig.is_chain),
+    //   its input vectors are fed back from ActUnit (OUTPE)
+    const unsigned int kChainManager = 2;
+    // input vectors per manager kept in registers by the pipelined FSM
+    const unsigned int kNumInputCache = 8;
+    // input vectors checked per cycle by zero skipping
+    const unsigned int kZeroSkipWindow = 8;
+    // maximum batch size (PEConfig.num_batch), one accumulator vector each, 
+    //   one input read port per batch, 1 (no batch mode) unless built with PE_BATCH
+    const unsigned int kMaxBatch = Input::kNumReadPorts;
   }
 }
 
@@ -101,6 +123,12 @@ class PEManager {
   
   spec::ClusterType cluster_lut;                // 128
   
+  // Input double buffering (PEConfig.is_input_dbuf): the second bank is
+  //   located at base_input + num_input, streamed input fills the bank that
+  //   is not read and SwapInputBank() at PE start makes it the read bank
+  NVUINT1   input_bank;
+  NVUINT1   is_input_filled;
+  
   PEManager() {  
     Reset();
   }  
@@ -114,6 +142,19 @@ class PEManager {
     base_weight = 0;                       
     base_bias = 0;                         
     base_input = 0;
+    ResetInputBank();
+  }
+  
+  void ResetInputBank() {
+    input_bank = 0;
+    is_input_filled = 0;
+  }
+  
+  void SwapInputBank() {
+    if (is_input_filled) {
+      input_bank = !input_bank;
+      is_input_filled = 0;
+    }
   }
   
   Address GetWeightAddr(Address input_index, Address output_index, bool is_cluster) const {
@@ -130,6 +171,17 @@ class PEManager {
   }
   
   Address GetInputAddr(Address input_index) const{
+    if (input_bank == 1) {
+      return input_index + base_input + num_input;
+    }
+    return input_index + base_input;
+  }
+  
+  // Address for streamed input (GB -> PE)
+  Address GetInputStreamAddr(Address input_index, bool is_dbuf) const{
+    if (is_dbuf && input_bank == 0) {
+      return input_index + base_input + num_input;
+    }
     return input_index + base_input;
   }
   
@@ -142,6 +194,7 @@ class PEManager {
     base_weight             = nvhls::get_slc<kAddressWidth>(write_data, 48);  
     base_bias               = nvhls::get_slc<kAddressWidth>(write_data, 64);  
     base_input              = nvhls::get_slc<kAddressWidth>(write_data, 80);  
+    ResetInputBank();
   }
 
   void PEManagerRead(NVUINTW(write_width)& read_data) const {
@@ -185,18 +238,33 @@ class PEConfig {
 
  public:
   NVUINT1   is_valid;
-  //NVUINT1   active_idx;
   NVUINT1   is_zero_first;
   NVUINT1   is_cluster;
   NVUINT1   is_bias;
   NVUINT4   num_manager;      // number of matrix-vector mul (1 or 2)
   NVUINT8   num_output;       // number of output vector per matrix vector mul (For LSTM it should be 4*num_output in act unit) 
+  NVUINT1   is_pingpong;      // split weight/input SRAM into two halves (address MSB)
+  NVUINT1   active_idx;       // half used by the datapath, AXI buffer access goes to the other half
+  NVUINT1   is_pipeline;      // overlap bias/output of a row with MAC of the next row
+  NVUINT1   is_zero_skip;     // skip MAC (and weight read) of all-zero input vectors
+  NVUINT1   is_input_dbuf;    // double buffer streamed input per manager, accept stream while computing
+  NVUINT1   is_gru;           // GRU: rows in groups of 3 (r, z, n), r and z sum all managers into one
+                              //   act_port vector, n keeps one vector per manager (x-side, h-side)
+  NVUINT1   is_chain;         // LSTMP/low-rank: after the last row, run kChainManager on the
+                              //   ActUnit feedback vectors (projection or U*(V*x))
+  NVUINT8   num_output_chain; // number of output vector of the chained matrix vector mul
+  NVUINT3   num_batch;        // batch mode: each weight block is applied to num_batch inputs, input i
+                              //   of batch b is at input index i*num_batch+b, act_port gets one vector 
+                              //   per batch (plain FSM only, no pipeline/zero skip/GRU/chain/dbuf),
+                              //   stored as written, NumBatch() is the batch size in use
   
   // Counters 
  protected:
   NVUINT4   manager_counter;
   NVUINT8   input_counter;
   NVUINT8   output_counter;
+  NVUINT2   gate_counter;     // output_counter % 3 for is_gru
+  NVUINT1   chain_phase;      // 1 while the chained matrix vector mul is pending or running
  
  public: 
   PEConfig() {  
@@ -204,9 +272,16 @@ class PEConfig {
   }  
   
   NVUINT4 ManagerIndex() const {
+    if (chain_phase) {
+      return spec::PE::kChainManager;
+    }
     return manager_counter;
   }
   
+  bool IsChainPhase() const {
+    return chain_phase;
+  }
+  
   NVUINT8 InputIndex() const {
     return input_counter;
   }  
@@ -215,14 +290,48 @@ class PEConfig {
     return output_counter;
   }  
   
+  // GRU r/z row: manager products are summed inside PE
+  bool IsFuseRow() const {
+    return is_gru && !chain_phase && (gate_counter != 2);
+  }
+  
+  // the row of a manager that is summed with the following manager, no act_port push
+  bool IsFuseHold() const {
+    return IsFuseRow() && (manager_counter != (num_manager - 1));
+  }
+  
+  // batch size in use, num_batch is kept as written (0 runs as 1, above kMaxBatch as kMaxBatch)
+  NVUINT3 NumBatch() const {
+    if (num_batch == 0) {
+      return 1;
+    }
+    if (num_batch > spec::PE::kMaxBatch) {
+      return spec::PE::kMaxBatch;
+    }
+    return num_batch;
+  }
+  
+  // the second input bank at base_input+num_input overlaps the batch inputs
+  bool IsInputDbuf() const {
+    return is_input_dbuf && (NumBatch() == 1);
+  }
+  
   void Reset() {
     is_valid      = 0;
-    //active_idx    = 1;    // preload on double_buffer[0], and after preload (please write this to 0)
     is_zero_first = 0;
     is_cluster    = 0;
     is_bias       = 0;
     num_manager    = 1;   // should be initialize to 1 to avoid error
     num_output    = 1;    // should be initialize to 1 to avoid error
+    is_pingpong   = 0;
+    active_idx    = 1;    // preload on double_buffer[0], and after preload (please write this to 0)
+    is_pipeline   = 0;
+    is_zero_skip  = 0;
+    is_input_dbuf = 0;
+    is_gru        = 0;
+    is_chain      = 0;
+    num_output_chain = 1; // should be initialize to 1 to avoid error
+    num_batch     = 1;
     
     ResetCounter();
   }
@@ -231,6 +340,8 @@ class PEConfig {
     manager_counter = 0;
     input_counter  = 0;
     output_counter = 0;  
+    gate_counter   = 0;
+    chain_phase    = 0;
   }
   
   // note that since num_input is in PEManager, needs a const parameter input
@@ -253,21 +364,42 @@ class PEConfig {
     }
   }
   
+  // Zero skipping, jump over input vectors that need no MAC
+  // (caller guarantees input_counter + num_skip < num_input)
+  void SkipInputCounter(const NVUINT8 num_skip) {
+    input_counter += num_skip;
+  }
+  
   // used after bias appending (a vector row of mul is done)
+  // with is_chain, the first is_output_end moves to chain_phase (IsChainPhase())
   void UpdateManagerCounter(bool& is_output_end) {
     is_output_end = 0;
+    // chained matrix vector mul, single manager
+    if (chain_phase) {
+      if (output_counter == (num_output_chain - 1)) {
+        output_counter = 0;
+        chain_phase = 0;
+        is_output_end = 1;
+      }
+      else {
+        output_counter += 1;
+      }
+    }
     // 2. update manager counter
-    if (manager_counter == (num_manager - 1)) {
+    else if (manager_counter == (num_manager - 1)) {
         manager_counter = 0;
       // 3. update output counter
       if (output_counter == (num_output - 1)) {
         output_counter = 0;
+        gate_counter = 0;
         // ready for next timestep
         is_zero_first = 0;
         is_output_end = 1;
+        chain_phase = is_chain;
       }
       else {
         output_counter += 1;
+        gate_counter = (gate_counter == 2) ? NVUINT2(0) : NVUINT2(gate_counter + 1);
       }
     }
     else {
@@ -279,22 +411,38 @@ class PEConfig {
     ResetCounter();
     is_valid              = nvhls::get_slc<1>(write_data, 0);
     is_zero_first         = nvhls::get_slc<1>(write_data, 8);
-    //active_idx            = nvhls::get_slc<1>(write_data, 16);
     is_cluster            = nvhls::get_slc<1>(write_data, 16);
     is_bias               = nvhls::get_slc<1>(write_data, 24);
     num_manager           = nvhls::get_slc<4>(write_data, 32);
     num_output            = nvhls::get_slc<8>(write_data, 40);
+    is_pingpong           = nvhls::get_slc<1>(write_data, 48);
+    active_idx            = nvhls::get_slc<1>(write_data, 56);
+    is_pipeline           = nvhls::get_slc<1>(write_data, 64);
+    is_zero_skip          = nvhls::get_slc<1>(write_data, 72);
+    is_input_dbuf         = nvhls::get_slc<1>(write_data, 80);
+    is_gru                = nvhls::get_slc<1>(write_data, 88);
+    is_chain              = nvhls::get_slc<1>(write_data, 96);
+    num_output_chain      = nvhls::get_slc<8>(write_data, 104);
+    num_batch             = nvhls::get_slc<3>(write_data, 112);
   }
 
   void PEConfigRead(NVUINTW(write_width)& read_data) const {
     read_data = 0;
     read_data.set_slc<1>(0, is_valid);
     read_data.set_slc<1>(8, is_zero_first);
-    //read_data.set_slc<1>(16, active_idx);    
     read_data.set_slc<1>(16, is_cluster);
     read_data.set_slc<1>(24, is_bias);
     read_data.set_slc<4>(32, num_manager);
     read_data.set_slc<8>(40, num_output); 
+    read_data.set_slc<1>(48, is_pingpong);
+    read_data.set_slc<1>(56, active_idx);
+    read_data.set_slc<1>(64, is_pipeline);
+    read_data.set_slc<1>(72, is_zero_skip);
+    read_data.set_slc<1>(80, is_input_dbuf);
+    read_data.set_slc<1>(88, is_gru);
+    read_data.set_slc<1>(96, is_chain);
+    read_data.set_slc<8>(104, num_output_chain);
+    read_data.set_slc<3>(112, num_batch);
   }
 };
 
@@ -31,8 +31,11 @@
 namespace spec {
   // Number of PEs
   const int kNumPE = 4;         
-  // Delay for Trigger signals (start, done) 
-  const int kGlobalTriggerDelay = 10; 
+  typedef NVUINTW(kNumPE) PEMaskType;
+  // PE groups for layer pipelining, one GBControl per group 
+  //   (bit i of the GB pe_group config is the group of PE i)
+  const int kNumPEGroups = 2;
+  typedef NVUINT1 PEGroupType;
   const int kVectorSize = 16;
   const int kNumVectorOutput = 1;   // cannot be changed anymore
   const int kNumVectorLanes = kNumVectorOutput*kVectorSize;
@@ -89,6 +92,9 @@ namespace spec {
   // data: VectorType
   // index: the index to locate memory manager ONLY for PE
   // logical_addr: the logical address, same as vector index
+  // group: PE group the data is sent to (GB -> PE) or received from (PE -> GB)
+  // pe_mask: PEs the data is sent to (GB -> PE only, unicast/multicast), 0: all PEs of the group
+  // pe_src: the PE the data is received from (PE -> GB only, one-hot, set by DataBus GBRecv)
 
   // Update 02142020
   // Customized datatype for channels  Need to inherit nvhls_message
@@ -97,18 +103,27 @@ namespace spec {
     VectorType data;
     NVUINT2 index;
     NVUINT8 logical_addr;
-    static const unsigned int width = 2 + 8 + VectorType::width;
+    PEGroupType group;
+    PEMaskType pe_mask;
+    PEMaskType pe_src;
+    static const unsigned int width = 2 + 8 + 1 + kNumPE + kNumPE + VectorType::width;
     
     template <unsigned int Size>
     void Marshall(Marshaller<Size>& m) {
       m & data;
       m & index;
       m & logical_addr;
+      m & group;
+      m & pe_mask;
+      m & pe_src;
     }
     StreamType() {
       data = 0;
       index = 0;
       logical_addr = 0;
+      group = 0;
+      pe_mask = 0;
+      pe_src = 0;
     }  
     
     StreamType operator= (const NVUINTW(width)& in) {
@@ -131,13 +146,16 @@ namespace spec {
     is_equal &= (lhs.data == rhs.data);
     is_equal &= (lhs.index == rhs.index);
     is_equal &= (lhs.logical_addr == rhs.logical_addr);
+    is_equal &= (lhs.group == rhs.group);
+    is_equal &= (lhs.pe_mask == rhs.pe_mask);
+    is_equal &= (lhs.pe_src == rhs.pe_src);
 
     return is_equal;
   }
 
   inline std::ostream& operator<<(std::ostream& os,
                                   const StreamType& _st) {
-    os << hex << " data = " << _st.data << " index = " << _st.index << " logical_addr = " << _st.logical_addr << endl;
+    os << hex << " data = " << _st.data << " index = " << _st.index << " logical_addr = " << _st.logical_addr << " group = " << _st.group << " pe_mask = " << _st.pe_mask << " pe_src = " << _st.pe_src << endl;
     
     return os;
   }